@@ -0,0 +1,57 @@
+#include <chrono>
+#include <format>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include "fatigue.hpp"
+
+using namespace fatigue;
+
+// Scan benchmark: searches a large buffer in this process through process_vm_readv
+// with an increasing number of worker threads, so no game needs to be running.
+// Usage: bench [size in MiB (default 512)] [max threads (default hardware threads)]
+
+int main(int argc, char* args[])
+{
+    log::setLogFormat(log::LogFormat::NoLabel);
+    log::setLogLevel(log::LogLevel::Info);
+
+    size_t sizeMb = argc > 1 ? std::stoul(args[1]) : 512;
+    unsigned maxThreads = argc > 2 ? std::stoul(args[2]) : std::max(std::thread::hardware_concurrency(), 1u);
+
+    // Fill the haystack with code-like noise (lots of zero bytes), and plant the needle near the end
+    std::vector<uint8_t> haystack(sizeMb * 1024 * 1024);
+    std::mt19937 rng(1234);
+    for (auto& byte : haystack) byte = rng() % 4 == 0 ? 0 : static_cast<uint8_t>(rng());
+
+    search::Pattern pattern = search::parsePattern("F3 0F 58 ?? 0F C6 ?? 00 0F 51 ?? F3 0F 59 ?? ?? ?? ?? ?? 0F 2F");
+    size_t planted = haystack.size() - 4096;
+    std::copy(pattern.bytes.begin(), pattern.bytes.end(), haystack.begin() + planted);
+
+    Region region(getpid(), reinterpret_cast<uintptr_t>(haystack.data()), reinterpret_cast<uintptr_t>(haystack.data() + haystack.size()), "bench");
+    region.method = mem::AccessMethod::SYS;
+
+    logInfo(std::format("Scanning {} MiB, search engine {}, up to {} threads",
+                        sizeMb, static_cast<int>(search::resolveEngine(search::getEngine())), maxThreads));
+
+    // Powers of two up to the max, then the max itself
+    std::vector<unsigned> counts;
+    for (unsigned threads = 1; threads < maxThreads; threads *= 2) counts.push_back(threads);
+    counts.push_back(maxThreads);
+
+    double baseline = 0;
+    for (unsigned threads : counts) {
+        auto begin = std::chrono::steady_clock::now();
+        auto found = scan::find(region, pattern, false, threads);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+        if (threads == 1) baseline = ms;
+        bool ok = !found.empty() && found.back() == planted;
+
+        logInfo(std::format("{:>3} threads: {:>9.1f} ms  {:>7.1f} MiB/s  x{:.2f}  ({} matches{})",
+                            threads, ms, sizeMb / (ms / 1000), baseline / ms, found.size(), ok ? "" : ", MISSING PLANTED MATCH"));
+    }
+
+    return 0;
+}
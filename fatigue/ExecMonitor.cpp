@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <errno.h>
+#include <format>
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "ExecMonitor.hpp"
+#include "log.hpp"
+
+namespace fatigue::proc {
+
+    ExecMonitor::ExecMonitor()
+    {
+        m_socket = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+        if (m_socket < 0) {
+            logDebug(std::format("Proc connector unavailable: {}", strerror(errno)));
+            return;
+        }
+
+        struct sockaddr_nl address{};
+        address.nl_family = AF_NETLINK;
+        address.nl_groups = CN_IDX_PROC;
+        address.nl_pid = 0;
+
+        if (bind(m_socket, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0 || !subscribe(true)) {
+            logDebug(std::format("Proc connector unavailable: {}", strerror(errno)));
+            close(m_socket);
+            m_socket = -1;
+        }
+    }
+
+    ExecMonitor::~ExecMonitor()
+    {
+        if (m_socket < 0) return;
+        subscribe(false);
+        close(m_socket);
+    }
+
+    bool ExecMonitor::subscribe(bool listen)
+    {
+        // Header, connector message, and the multicast op, laid out back to back
+        const size_t size = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op));
+        alignas(struct nlmsghdr) char request[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op))]{};
+
+        auto* header = reinterpret_cast<struct nlmsghdr*>(request);
+        header->nlmsg_len = size;
+        header->nlmsg_type = NLMSG_DONE;
+        header->nlmsg_pid = getpid();
+
+        auto* message = static_cast<struct cn_msg*>(NLMSG_DATA(header));
+        message->id.idx = CN_IDX_PROC;
+        message->id.val = CN_VAL_PROC;
+        message->len = sizeof(enum proc_cn_mcast_op);
+
+        enum proc_cn_mcast_op op = listen ? PROC_CN_MCAST_LISTEN : PROC_CN_MCAST_IGNORE;
+        memcpy(message->data, &op, sizeof(op));
+
+        return send(m_socket, request, size, 0) == static_cast<ssize_t>(size);
+    }
+
+    pid_t ExecMonitor::next(int timeoutMs)
+    {
+        if (m_socket < 0) return -1;
+
+        alignas(struct nlmsghdr) char buffer[4096];
+        // Fork and exit events arrive too, so keep track of the time left across them
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+        while (true) {
+            int remaining = timeoutMs;
+            if (timeoutMs > 0) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+                remaining = static_cast<int>(std::max<long long>(left.count(), 0));
+            }
+
+            struct pollfd fd = { .fd = m_socket, .events = POLLIN, .revents = 0 };
+            int ready = poll(&fd, 1, remaining);
+            if (ready < 0 && errno == EINTR) continue;
+            if (ready <= 0) return ready == 0 ? 0 : -1;
+
+            ssize_t length = recv(m_socket, buffer, sizeof(buffer), 0);
+            if (length < 0) {
+                // Events were dropped (the socket buffer overflowed), return as if timed out so the caller rescans
+                if (errno == ENOBUFS) return 0;
+                if (errno == EINTR) continue;
+                return -1;
+            }
+
+            for (auto* header = reinterpret_cast<struct nlmsghdr*>(buffer); NLMSG_OK(header, length); header = NLMSG_NEXT(header, length)) {
+                if (header->nlmsg_type == NLMSG_ERROR || header->nlmsg_type == NLMSG_NOOP) continue;
+
+                auto* message = static_cast<struct cn_msg*>(NLMSG_DATA(header));
+                if (message->id.idx != CN_IDX_PROC || message->id.val != CN_VAL_PROC) continue;
+
+                // The event is not 8 byte aligned after the connector header, copy it out
+                struct proc_event event{};
+                memcpy(&event, message->data, std::min<size_t>(message->len, sizeof(event)));
+                if (event.what == proc_event::PROC_EVENT_EXEC) return event.event_data.exec.process_tgid;
+                if (event.what == proc_event::PROC_EVENT_COMM) return event.event_data.comm.process_tgid;
+            }
+        }
+    }
+} // namespace fatigue::proc
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <sys/types.h>
+
+namespace fatigue::proc {
+    /**
+     * @brief Notifications of processes starting, from the kernel proc connector
+     * Subscribes to netlink PROC_EVENT_EXEC (a process ran a new program) and PROC_EVENT_COMM
+     * (a process renamed itself, e.g. Wine setting the name to the exe) events, so a waiter can
+     * check the new process the moment it appears instead of rescanning /proc on a timer.
+     * Listening needs CAP_NET_ADMIN; without it isListening() is false and callers should poll.
+     */
+    class ExecMonitor {
+    protected:
+        int m_socket{-1};
+
+        bool subscribe(bool listen);
+
+    public:
+        ExecMonitor();
+        ~ExecMonitor();
+
+        ExecMonitor(const ExecMonitor&) = delete;
+        ExecMonitor& operator=(const ExecMonitor&) = delete;
+
+        /** Check if events are being received */
+        inline bool isListening() const { return m_socket >= 0; }
+
+        /**
+         * Wait for the next exec or rename
+         * @param timeoutMs Milliseconds to wait, negative to wait forever
+         * @return Pid (thread group id) of the process, 0 on timeout, -1 if not listening or on error
+         */
+        pid_t next(int timeoutMs);
+    };
+} // namespace fatigue::proc
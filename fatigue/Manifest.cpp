@@ -0,0 +1,525 @@
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <unistd.h>
+#include "Manifest.hpp"
+
+namespace fatigue {
+
+    namespace {
+        const std::string_view s_magic = "MFMANIF1";
+
+        /** Drop a trailing comment, patterns and values never contain '#' or ';' */
+        inline std::string_view stripComment(std::string_view line)
+        {
+            size_t comment = line.find_first_of("#;");
+            return comment == std::string_view::npos ? line : line.substr(0, comment);
+        }
+
+        /** Split a comma separated list, trimming every item and skipping empty ones */
+        std::vector<std::string> splitList(std::string_view value)
+        {
+            std::vector<std::string> items;
+            while (!value.empty()) {
+                size_t comma = value.find(',');
+                std::string item = string::trim(value.substr(0, comma));
+                if (!item.empty()) items.push_back(std::move(item));
+                if (comma == std::string_view::npos) break;
+                value.remove_prefix(comma + 1);
+            }
+            return items;
+        }
+
+        template <typename T>
+        bool encodeNumber(std::string_view text, std::vector<uint8_t>& data)
+        {
+            T value;
+            if (!string::parseNumber(text, value)) return false;
+            data = hex::parse(&value, sizeof(value));
+            return true;
+        }
+
+        /** Parse patch data: hex bytes, or "<type>:<value>" stored little endian */
+        bool parseData(std::string_view value, std::vector<uint8_t>& data)
+        {
+            size_t colon = value.find(':');
+            if (colon == std::string_view::npos) {
+                if (!hex::isValid(value, true)) return false;
+                data = hex::parse(value);
+                return !data.empty();
+            }
+
+            std::string type = string::toLower(string::trim(value.substr(0, colon)));
+            std::string_view number = value.substr(colon + 1);
+
+            if (type == "int8") return encodeNumber<int8_t>(number, data);
+            if (type == "int16") return encodeNumber<int16_t>(number, data);
+            if (type == "int32") return encodeNumber<int32_t>(number, data);
+            if (type == "int64") return encodeNumber<int64_t>(number, data);
+            if (type == "uint8") return encodeNumber<uint8_t>(number, data);
+            if (type == "uint16") return encodeNumber<uint16_t>(number, data);
+            if (type == "uint32") return encodeNumber<uint32_t>(number, data);
+            if (type == "uint64") return encodeNumber<uint64_t>(number, data);
+            if (type == "float") return encodeNumber<float>(number, data);
+            if (type == "double") return encodeNumber<double>(number, data);
+            return false;
+        }
+
+        /** Parse "<n>", "rel32(<n>)", or "rel32(<n>) +/- <n>" */
+        bool parseOffset(std::string_view value, int32_t& offset, int32_t& relative)
+        {
+            std::string text = string::compact(value);
+            std::string_view rest = text;
+            offset = 0;
+            relative = -1;
+
+            if (rest.starts_with("rel32(")) {
+                size_t close = rest.find(')');
+                if (close == std::string_view::npos || !string::parseNumber(rest.substr(6, close - 6), relative) || relative < 0) return false;
+
+                rest.remove_prefix(close + 1);
+                if (rest.empty()) return true;
+                if (rest.front() != '+' && rest.front() != '-') return false;
+            }
+
+            return string::parseNumber(rest, offset);
+        }
+
+        // Compiled form, native byte order (it is only ever read on the machine that wrote it)
+
+        class Writer {
+        public:
+            std::string out;
+
+            template <typename T>
+            void put(T value) { out.append(reinterpret_cast<const char*>(&value), sizeof(T)); }
+            void put(std::string_view value)
+            {
+                put(static_cast<uint32_t>(value.size()));
+                out.append(value);
+            }
+            void put(const std::vector<uint8_t>& value)
+            {
+                put(std::string_view(reinterpret_cast<const char*>(value.data()), value.size()));
+            }
+            void put(const std::vector<std::string>& values)
+            {
+                put(static_cast<uint32_t>(values.size()));
+                for (const std::string& value : values) put(std::string_view(value));
+            }
+        };
+
+        class Reader {
+        protected:
+            std::string_view m_in;
+            size_t m_offset{0};
+            bool m_good{true};
+
+        public:
+            explicit Reader(std::string_view in) : m_in(in) {}
+
+            inline bool good() const { return m_good; }
+            inline bool done() const { return m_offset == m_in.size(); }
+
+            template <typename T>
+            bool get(T& value)
+            {
+                if (!m_good || m_in.size() - m_offset < sizeof(T)) return m_good = false;
+                memcpy(&value, m_in.data() + m_offset, sizeof(T));
+                m_offset += sizeof(T);
+                return true;
+            }
+            bool get(std::string& value)
+            {
+                uint32_t size = 0;
+                if (!get(size) || m_in.size() - m_offset < size) return m_good = false;
+                value.assign(m_in.substr(m_offset, size));
+                m_offset += size;
+                return true;
+            }
+            bool get(std::vector<uint8_t>& value)
+            {
+                std::string bytes;
+                if (!get(bytes)) return false;
+                value.assign(bytes.begin(), bytes.end());
+                return true;
+            }
+            bool get(std::vector<std::string>& values)
+            {
+                uint32_t count = 0;
+                // Every string takes at least its size field, a larger count is corrupt
+                if (!get(count) || count > (m_in.size() - m_offset) / sizeof(uint32_t)) return m_good = false;
+                values.resize(count);
+                for (std::string& value : values) get(value);
+                return m_good;
+            }
+        };
+    } // namespace
+
+    Manifest::Manifest(const std::string& path, bool useCompiled) : m_path(path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            logError(std::format("Failed to open manifest {}", path));
+            return;
+        }
+        std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        uint64_t key = hash::xxh64(text.data(), text.size());
+        std::string compiled = compiledPath(path);
+
+        if (useCompiled && loadCompiled(compiled, key)) {
+            logDebug(std::format("Loaded compiled manifest {}", compiled));
+            m_valid = true;
+            m_precompiled = true;
+            return;
+        }
+
+        m_valid = parse(text);
+        if (m_valid && useCompiled) saveCompiled(compiled, key);
+    }
+
+    bool Manifest::parse(std::string_view text)
+    {
+        enum class Block { None, Manifest, Variant, Patch };
+        Block block = Block::None;
+        size_t lineNumber = 0;
+        bool valid = true;
+        std::vector<size_t> patchLines;
+
+        auto fail = [&](std::string_view message) {
+            logError(std::format("{}:{}: {}", m_path, lineNumber, message));
+            valid = false;
+        };
+
+        while (!text.empty()) {
+            size_t newline = text.find('\n');
+            std::string line = string::trim(stripComment(text.substr(0, newline)));
+            text.remove_prefix(newline == std::string_view::npos ? text.size() : newline + 1);
+            lineNumber++;
+
+            if (line.empty()) continue;
+
+            // [manifest], [variant <name>], [patch <name>]
+            if (line.front() == '[') {
+                block = Block::None;
+                if (line.back() != ']') {
+                    fail("Expected ']'");
+                    continue;
+                }
+
+                std::string header = string::trim(std::string_view(line).substr(1, line.size() - 2));
+                size_t space = header.find(' ');
+                std::string kind = string::toLower(header.substr(0, space));
+                std::string name = space == std::string::npos ? "" : string::trim(std::string_view(header).substr(space + 1));
+
+                if (kind == "manifest" && name.empty()) {
+                    block = Block::Manifest;
+                } else if (kind == "variant" && !name.empty()) {
+                    block = Block::Variant;
+                    m_variants.push_back({.name = name, .fingerprints = {}});
+                } else if (kind == "patch" && !name.empty()) {
+                    block = Block::Patch;
+                    m_patches.push_back({.name = name, .group = name});
+                    patchLines.push_back(lineNumber);
+                } else {
+                    fail(std::format("Unknown block [{}]", header));
+                }
+                continue;
+            }
+
+            size_t equals = line.find('=');
+            if (equals == std::string::npos) {
+                fail("Expected 'key = value'");
+                continue;
+            }
+            std::string key = string::toLower(string::trim(std::string_view(line).substr(0, equals)));
+            std::string value = string::trim(std::string_view(line).substr(equals + 1));
+            if (value.empty()) {
+                fail(std::format("Missing value for '{}'", key));
+                continue;
+            }
+
+            if (block == Block::Manifest) {
+                if (key == "name") {
+                    m_name = value;
+                } else if (key == "process") {
+                    for (std::string& process : splitList(value)) m_processes.push_back(std::move(process));
+                } else if (key == "module") {
+                    m_module = value;
+                } else {
+                    fail(std::format("Unknown manifest key '{}'", key));
+                }
+
+            } else if (block == Block::Variant) {
+                ManifestVariant& variant = m_variants.back();
+                if (key == "fingerprint") {
+                    for (const std::string& item : splitList(value)) {
+                        uint64_t fingerprint = 0;
+                        if (string::parseNumber(item, fingerprint)) {
+                            variant.fingerprints.push_back(fingerprint);
+                        } else {
+                            fail(std::format("Invalid fingerprint '{}'", item));
+                        }
+                    }
+                } else {
+                    fail(std::format("Unknown variant key '{}'", key));
+                }
+
+            } else if (block == Block::Patch) {
+                ManifestPatch& patch = m_patches.back();
+                if (key == "group") {
+                    patch.group = value;
+                } else if (key == "section") {
+                    patch.section = value;
+                } else if (key == "pattern") {
+                    if (hex::isValid(value, false)) {
+                        patch.pattern = hex::prettify(string::compact(value));
+                        patch.compiled = search::parsePattern(patch.pattern);
+                    } else {
+                        fail(std::format("Invalid pattern '{}'", value));
+                    }
+                } else if (key == "address") {
+                    if (!string::parseNumber(value, patch.address) || patch.address < 0) fail(std::format("Invalid address '{}'", value));
+                } else if (key == "offset") {
+                    if (!parseOffset(value, patch.offset, patch.relative)) fail(std::format("Invalid offset '{}'", value));
+                } else if (key == "patch") {
+                    if (!parseData(value, patch.data)) fail(std::format("Invalid patch '{}'", value));
+                } else if (key == "variant") {
+                    patch.variants = splitList(value);
+                } else {
+                    fail(std::format("Unknown patch key '{}'", key));
+                }
+
+            } else {
+                fail(std::format("'{}' outside of a block", key));
+            }
+        }
+
+        // Check every patch is complete, reporting the line of its block
+        for (size_t i = 0; i < m_patches.size(); i++) {
+            const ManifestPatch& patch = m_patches.at(i);
+            lineNumber = patchLines.at(i);
+
+            if (patch.pattern.empty() == (patch.address < 0)) {
+                fail(std::format("Patch '{}' needs either a pattern or an address", patch.name));
+            }
+            if (patch.isRelative() && patch.pattern.empty()) {
+                fail(std::format("Patch '{}' has a rel32 offset but no pattern", patch.name));
+            }
+            if (patch.data.empty()) {
+                fail(std::format("Patch '{}' has no patch data", patch.name));
+            }
+            for (const std::string& name : patch.variants) {
+                auto found = std::find_if(m_variants.begin(), m_variants.end(), [&](const ManifestVariant& variant) { return variant.name == name; });
+                if (found == m_variants.end()) fail(std::format("Patch '{}' uses unknown variant '{}'", patch.name, name));
+            }
+        }
+
+        if (m_processes.empty()) {
+            logError(std::format("{}: No process in [manifest]", m_path));
+            valid = false;
+        }
+        if (m_patches.empty()) {
+            logError(std::format("{}: No patches", m_path));
+            valid = false;
+        }
+
+        return valid;
+    }
+
+    bool Manifest::loadCompiled(const std::string& path, uint64_t key)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) return false;
+        std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        if (!std::string_view(data).starts_with(s_magic)) return false;
+        Reader in(std::string_view(data).substr(s_magic.size()));
+
+        uint64_t compiledKey = 0;
+        if (!in.get(compiledKey) || compiledKey != key) return false;
+
+        // Fill copies, so a corrupt file leaves nothing half loaded
+        std::string name, module;
+        std::vector<std::string> processes;
+        std::vector<ManifestVariant> variants;
+        std::vector<ManifestPatch> patches;
+        uint32_t count = 0;
+
+        in.get(name);
+        in.get(processes);
+        in.get(module);
+
+        in.get(count);
+        for (uint32_t i = 0; i < count && in.good(); i++) {
+            ManifestVariant variant;
+            uint32_t fingerprints = 0;
+            in.get(variant.name);
+            in.get(fingerprints);
+            for (uint32_t j = 0; j < fingerprints && in.good(); j++) {
+                uint64_t fingerprint = 0;
+                if (in.get(fingerprint)) variant.fingerprints.push_back(fingerprint);
+            }
+            variants.push_back(std::move(variant));
+        }
+
+        in.get(count);
+        for (uint32_t i = 0; i < count && in.good(); i++) {
+            ManifestPatch patch;
+            in.get(patch.name);
+            in.get(patch.group);
+            in.get(patch.section);
+            in.get(patch.pattern);
+            in.get(patch.compiled.bytes);
+            in.get(patch.compiled.mask);
+            in.get(patch.address);
+            in.get(patch.offset);
+            in.get(patch.relative);
+            in.get(patch.data);
+            in.get(patch.variants);
+            patches.push_back(std::move(patch));
+        }
+
+        if (!in.good() || !in.done()) {
+            logDebug(std::format("Ignoring corrupt compiled manifest {}", path));
+            return false;
+        }
+
+        m_name = std::move(name);
+        m_processes = std::move(processes);
+        m_module = std::move(module);
+        m_variants = std::move(variants);
+        m_patches = std::move(patches);
+        return true;
+    }
+
+    bool Manifest::saveCompiled(const std::string& path, uint64_t key) const
+    {
+        Writer out;
+        out.out.append(s_magic);
+        out.put(key);
+
+        out.put(std::string_view(m_name));
+        out.put(m_processes);
+        out.put(std::string_view(m_module));
+
+        out.put(static_cast<uint32_t>(m_variants.size()));
+        for (const ManifestVariant& variant : m_variants) {
+            out.put(std::string_view(variant.name));
+            out.put(static_cast<uint32_t>(variant.fingerprints.size()));
+            for (uint64_t fingerprint : variant.fingerprints) out.put(fingerprint);
+        }
+
+        out.put(static_cast<uint32_t>(m_patches.size()));
+        for (const ManifestPatch& patch : m_patches) {
+            out.put(std::string_view(patch.name));
+            out.put(std::string_view(patch.group));
+            out.put(std::string_view(patch.section));
+            out.put(std::string_view(patch.pattern));
+            out.put(patch.compiled.bytes);
+            out.put(std::string_view(patch.compiled.mask));
+            out.put(patch.address);
+            out.put(patch.offset);
+            out.put(patch.relative);
+            out.put(patch.data);
+            out.put(patch.variants);
+        }
+
+        // Write next to the destination and rename over it, like the signature cache
+        std::error_code error;
+        std::string temporary = std::format("{}.{}.tmp", path, getpid());
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            file.write(out.out.data(), static_cast<std::streamsize>(out.out.size()));
+            if (!file.good()) {
+                // Usually a read-only directory, the text manifest still works
+                logDebug(std::format("Failed to write compiled manifest {}", temporary));
+                std::filesystem::remove(temporary, error);
+                return false;
+            }
+        }
+
+        std::filesystem::rename(temporary, path, error);
+        if (error) {
+            logDebug(std::format("Failed to save compiled manifest {}: {}", path, error.message()));
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+        return true;
+    }
+
+    std::vector<std::string> Manifest::groups() const
+    {
+        std::vector<std::string> names;
+        for (const ManifestPatch& patch : m_patches) {
+            if (std::find(names.begin(), names.end(), patch.group) == names.end()) names.push_back(patch.group);
+        }
+        return names;
+    }
+
+    const ManifestVariant* Manifest::findVariant(uint64_t fingerprint) const
+    {
+        const ManifestVariant* fallback = nullptr;
+        for (const ManifestVariant& variant : m_variants) {
+            if (std::find(variant.fingerprints.begin(), variant.fingerprints.end(), fingerprint) != variant.fingerprints.end()) return &variant;
+            if (!fallback && variant.fingerprints.empty()) fallback = &variant;
+        }
+        return fallback;
+    }
+
+    std::vector<std::pair<std::string, PatchSet>> Manifest::patchSets(const pe::PeMap& module, const ManifestVariant* variant, const std::vector<std::string>& groups) const
+    {
+        std::vector<std::string> known = this->groups();
+        for (const std::string& group : groups) {
+            if (std::find(known.begin(), known.end(), group) == known.end()) logWarning(std::format("Unknown patch group '{}'", group));
+        }
+
+        std::vector<std::pair<std::string, PatchSet>> sets;
+        std::vector<std::string> skipped;
+
+        for (const ManifestPatch& patch : m_patches) {
+            if (!groups.empty() && std::find(groups.begin(), groups.end(), patch.group) == groups.end()) continue;
+            if (!patch.variants.empty() && (!variant || std::find(patch.variants.begin(), patch.variants.end(), variant->name) == patch.variants.end())) continue;
+            if (std::find(skipped.begin(), skipped.end(), patch.group) != skipped.end()) continue;
+
+            auto set = std::find_if(sets.begin(), sets.end(), [&](const auto& entry) { return entry.first == patch.group; });
+
+            const pe::Section* section = module.findSection(patch.section);
+            if (!section) {
+                logWarning(std::format("Section '{}' of patch '{}' not found, skipping group '{}'", patch.section, patch.name, patch.group));
+                skipped.push_back(patch.group);
+                if (set != sets.end()) sets.erase(set);
+                continue;
+            }
+
+            if (set == sets.end()) {
+                sets.emplace_back(patch.group, PatchSet());
+                set = std::prev(sets.end());
+            }
+
+            if (patch.pattern.empty()) {
+                set->second.add(section->region, static_cast<uintptr_t>(patch.address), patch.data);
+            } else if (patch.isRelative()) {
+                // The target of a rel32 is usually in another section (e.g. a constant in .rdata), so
+                // the patch is written without the bounds of the section searched, like the sekiro patcher
+                Region region = section->region;
+                region.enforceBounds = false;
+
+                // The rel32 displacement ends the instruction, its target is relative to the next byte
+                set->second.add(region, patch.pattern, patch.compiled,
+                    [relative = patch.relative, offset = patch.offset](Patch const& match) {
+                        int32_t displacement = 0;
+                        match.region().read(match.address() + relative, &displacement);
+                        return relative + 4 + displacement + offset;
+                    },
+                    patch.data);
+            } else {
+                set->second.add(section->region, patch.pattern, patch.compiled, patch.offset, patch.data);
+            }
+        }
+
+        return sets;
+    }
+} // namespace fatigue
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "pe.hpp"
+#include "PatchSet.hpp"
+#include "utils.hpp"
+
+namespace fatigue {
+    /** One build of the target, told apart by PeMap::fingerprint() */
+    struct ManifestVariant {
+        std::string name;
+        /** Fingerprints of the builds this variant covers, none for a fallback variant */
+        std::vector<uint64_t> fingerprints;
+    };
+
+    /** One patch of a manifest, with its pattern already parsed */
+    struct ManifestPatch {
+        std::string name;
+        /** Patches of a group are applied together or not at all, defaults to the patch name */
+        std::string group;
+        std::string section{".text"};
+        std::string pattern;
+        search::Pattern compiled;
+        /** Offset into the section when there is no pattern, -1 if unused */
+        int64_t address{-1};
+        /** Offset from the match, or added to the rel32 target if relative >= 0 */
+        int32_t offset{0};
+        /** Position (from the match) of a rel32 displacement to follow, -1 if unused */
+        int32_t relative{-1};
+        std::vector<uint8_t> data;
+        /** Variants this patch applies to, empty for all */
+        std::vector<std::string> variants;
+
+        inline bool isRelative() const { return relative >= 0; }
+    };
+
+    /**
+     * @brief Declarative patch list for one game (or any PE process)
+     * An INI style text file replaces a hand written patcher and its PATTERN_* / *_OFFSET / PATCH_*
+     * constants:
+     *
+     *     # Comments start with '#' or ';'
+     *     [manifest]
+     *     name = Sekiro
+     *     process = sekiro.exe           ; status names, comma separated
+     *     module = sekiro.exe            ; map to patch, defaults to the first process
+     *
+     *     [variant 1.06]
+     *     fingerprint = 0x1234abcd5678ef90   ; PeMap::fingerprint() of the build, comma separated
+     *
+     *     [patch speedfix]
+     *     group = fps                    ; applied with the other "fps" patches, or not at all
+     *     section = .text
+     *     pattern = F3 0F 58 ?? 0F C6 ?? 00 0F 51 ?? F3 0F 59 ?? ?? ?? ?? ?? 0F 2F
+     *     offset = rel32(15)             ; target of the rel32 at match + 15, "rel32(15) + 4" also works
+     *     patch = float:72               ; hex bytes, or int8..int64, uint8..uint64, float, double
+     *     variant = 1.06                 ; only for these variants (comma separated), default all
+     *
+     * A patch may use "address = <offset in section>" instead of a pattern.
+     * Loading a manifest also writes a compiled copy next to it (see compiledPath()) holding the
+     * parsed patterns and patch bytes; it is used as long as the text has the same XXH64, so
+     * startup skips parsing entirely.
+     */
+    class Manifest {
+    protected:
+        std::string m_path{};
+        std::string m_name{};
+        std::vector<std::string> m_processes{};
+        std::string m_module{};
+        std::vector<ManifestVariant> m_variants{};
+        std::vector<ManifestPatch> m_patches{};
+        bool m_valid{false};
+        bool m_precompiled{false};
+
+        /** Parse the manifest text, logging every error with its line number */
+        bool parse(std::string_view text);
+        /** Load the compiled copy if it was made from text with this hash */
+        bool loadCompiled(const std::string& path, uint64_t key);
+        bool saveCompiled(const std::string& path, uint64_t key) const;
+
+    public:
+        Manifest() = default;
+        /**
+         * @param path Manifest file
+         * @param useCompiled Load (and refresh) the compiled copy next to the manifest
+         */
+        explicit Manifest(const std::string& path, bool useCompiled = true);
+        ~Manifest() = default;
+
+        /** Get the path of the compiled copy of a manifest */
+        static inline std::string compiledPath(const std::string& path) { return path + ".bin"; }
+
+        inline bool isValid() const { return m_valid; }
+        /** Check if the manifest was loaded from its compiled copy */
+        inline bool isPrecompiled() const { return m_precompiled; }
+        inline const std::string& path() const { return m_path; }
+        inline const std::string& name() const { return m_name; }
+        inline const std::vector<std::string>& processes() const { return m_processes; }
+        /** Get the module (map name) to patch, the first process if not set */
+        inline const std::string& module() const { return m_module.empty() && !m_processes.empty() ? m_processes.front() : m_module; }
+        inline const std::vector<ManifestVariant>& variants() const { return m_variants; }
+        inline const std::vector<ManifestPatch>& patches() const { return m_patches; }
+
+        /** Get the group names, in order of first appearance */
+        std::vector<std::string> groups() const;
+
+        /**
+         * Pick the variant of a build
+         * @return The variant listing the fingerprint, else the first variant without fingerprints, else nullptr
+         */
+        const ManifestVariant* findVariant(uint64_t fingerprint) const;
+
+        /**
+         * @brief Build one PatchSet per group, ready to resolve and apply
+         * Patches restricted to other variants are left out, and so are patches whose section is not
+         * in the module (with a warning, which also leaves out the rest of their group).
+         * @param variant Build variant (@see findVariant), nullptr to only use patches for all variants
+         * @param groups Groups to build, empty for all
+         */
+        std::vector<std::pair<std::string, PatchSet>> patchSets(const pe::PeMap& module, const ManifestVariant* variant, const std::vector<std::string>& groups = {}) const;
+    };
+} // namespace fatigue
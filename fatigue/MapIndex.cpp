@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <cstring>
+#include <elf.h>
+#include "MapIndex.hpp"
+#include "mem.hpp"
+#include "pe.hpp"
+
+namespace fatigue::proc {
+
+    uint8_t parsePerms(std::string_view perms)
+    {
+        uint8_t bits = 0;
+        if (perms.size() > 0 && perms[0] == 'r') bits |= PERM_READ;
+        if (perms.size() > 1 && perms[1] == 'w') bits |= PERM_WRITE;
+        if (perms.size() > 2 && perms[2] == 'x') bits |= PERM_EXEC;
+        if (perms.size() > 3 && perms[3] == 'p') bits |= PERM_PRIVATE;
+        if (perms.size() > 3 && perms[3] == 's') bits |= PERM_SHARED;
+        return bits;
+    }
+
+    MapIndex::MapIndex(pid_t pid, bool images)
+    {
+        load(pid, images);
+    }
+
+    bool MapIndex::load(pid_t pid, bool images)
+    {
+        m_entries.clear();
+        if (!m_table.load(pid)) return false;
+
+        for (const MapEntry& map : m_table) {
+            if (!map.isValid()) continue;
+            m_entries.push_back({.map = map, .perms = parsePerms(map.perms)});
+        }
+
+        // The kernel lists maps in address order, but don't rely on it for the binary search
+        auto byStart = [](const Entry& a, const Entry& b) { return a.map.start < b.map.start; };
+        if (!std::is_sorted(m_entries.begin(), m_entries.end(), byStart)) {
+            std::sort(m_entries.begin(), m_entries.end(), byStart);
+        }
+
+        if (images) detectImages();
+        return true;
+    }
+
+    void MapIndex::detectImages()
+    {
+        // Image headers live at offset 0 of a readable file map; read every candidate in one batch
+        std::vector<size_t> candidates;
+        for (size_t i = 0; i < m_entries.size(); i++) {
+            const Entry& entry = m_entries.at(i);
+            if (entry.map.isFile() && entry.map.offset == 0 && entry.has(PERM_READ)) candidates.push_back(i);
+        }
+        if (candidates.empty()) return;
+
+        std::vector<uint32_t> magic(candidates.size(), 0);
+        std::vector<mem::ReadRequest> requests(candidates.size());
+        for (size_t i = 0; i < candidates.size(); i++) {
+            requests.at(i) = {.address = m_entries.at(candidates.at(i)).map.start, .buffer = &magic.at(i), .size = sizeof(uint32_t)};
+        }
+        mem::sys::readv(pid(), requests);
+
+        for (size_t i = 0; i < candidates.size(); i++) {
+            if (!requests.at(i).complete()) continue;
+
+            ImageType type = ImageType::None;
+            if (memcmp(&magic.at(i), ELFMAG, SELFMAG) == 0) {
+                type = ImageType::ELF;
+            } else if (static_cast<uint16_t>(magic.at(i)) == pe::DOS_MAGIC) {
+                type = ImageType::PE;
+            }
+            if (type == ImageType::None) continue;
+
+            // The header map and the maps of the same file right after it make up the image
+            size_t first = candidates.at(i);
+            const MapEntry& header = m_entries.at(first).map;
+            for (size_t j = first; j < m_entries.size(); j++) {
+                Entry& entry = m_entries.at(j);
+                if (j > first && (entry.map.inode != header.inode || entry.map.name != header.name || entry.map.offset == 0)) break;
+                entry.image = type;
+                entry.imageBase = header.start;
+            }
+        }
+    }
+
+    const MapIndex::Entry* MapIndex::find(uintptr_t address) const
+    {
+        // Last map starting at or before the address is the only one that can contain it
+        auto it = std::upper_bound(m_entries.begin(), m_entries.end(), address, [](uintptr_t value, const Entry& entry) {
+            return value < entry.map.start;
+        });
+        if (it == m_entries.begin()) return nullptr;
+
+        --it;
+        return it->map.contains(address) ? &*it : nullptr;
+    }
+
+    bool MapIndex::contains(uintptr_t address, size_t size, uint8_t perms) const
+    {
+        if (size == 0) return false;
+
+        uintptr_t end = address + size;
+        while (address < end) {
+            const Entry* entry = find(address);
+            if (!entry || !entry->has(perms)) return false;
+            address = entry->map.end;
+        }
+        return true;
+    }
+
+    std::vector<const MapIndex::Entry*> MapIndex::filter(uint8_t perms) const
+    {
+        std::vector<const Entry*> found;
+        for (const Entry& entry : m_entries) {
+            if (entry.has(perms)) found.push_back(&entry);
+        }
+        return found;
+    }
+} // namespace fatigue::proc
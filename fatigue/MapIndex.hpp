@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <sys/types.h>
+#include <vector>
+#include "MapTable.hpp"
+#include "proc.hpp"
+
+namespace fatigue::proc {
+    /** Permission bits of a map (see MapIndex::Entry::perms) */
+    const uint8_t PERM_READ = 1 << 0;
+    const uint8_t PERM_WRITE = 1 << 1;
+    const uint8_t PERM_EXEC = 1 << 2;
+    const uint8_t PERM_PRIVATE = 1 << 3;
+    const uint8_t PERM_SHARED = 1 << 4;
+
+    /** Convert a maps permission string (e.g. "r-xp") to PERM_* bits */
+    uint8_t parsePerms(std::string_view perms);
+
+    /** Executable image a map belongs to */
+    enum class ImageType : uint8_t {
+        None,
+        PE,
+        ELF
+    };
+
+    /**
+     * @brief Sorted snapshot of a process' maps for fast address lookups
+     * Built from a single read of /proc/[pid]/maps (see MapTable, which it owns), so names are
+     * not copied. find() is a binary search over the map starts. Permissions are precomputed as
+     * PERM_* bitmasks, and maps are flagged with the PE or ELF image they are part of: a file map
+     * at offset 0 that starts with MZ or ELF magic, and the following maps of the same file.
+     * The index does not follow changes to the process, call load() again to rebuild it.
+     */
+    class MapIndex {
+    public:
+        struct Entry {
+            /** Parsed maps line (text fields point into the index) */
+            MapEntry map{};
+            /** PERM_* bits */
+            uint8_t perms{0};
+            ImageType image{ImageType::None};
+            /** Start of the map holding the image headers, if part of an image */
+            uintptr_t imageBase{0};
+
+            inline bool has(uint8_t mask) const { return (perms & mask) == mask; }
+            inline bool isImage() const { return image != ImageType::None; }
+        };
+
+    protected:
+        MapTable m_table{};
+        std::vector<Entry> m_entries{};
+
+        void detectImages();
+
+    public:
+        MapIndex() = default;
+        /** Build the index for a process (see load()) */
+        explicit MapIndex(pid_t pid, bool images = true);
+        ~MapIndex() = default;
+
+        // Entries point into the owned table, so the index can be moved but not copied
+        MapIndex(const MapIndex&) = delete;
+        MapIndex& operator=(const MapIndex&) = delete;
+        MapIndex(MapIndex&&) = default;
+        MapIndex& operator=(MapIndex&&) = default;
+
+        /**
+         * Read the maps of a process and rebuild the index
+         * @param images If true, read the first bytes of file maps to flag PE and ELF images
+         * @return false if the maps could not be read
+         */
+        bool load(pid_t pid, bool images = true);
+
+        inline pid_t pid() const { return m_table.pid(); }
+        inline size_t size() const { return m_entries.size(); }
+        inline bool empty() const { return m_entries.empty(); }
+        inline const Entry& at(size_t index) const { return m_entries.at(index); }
+        inline std::vector<Entry>::const_iterator begin() const { return m_entries.begin(); }
+        inline std::vector<Entry>::const_iterator end() const { return m_entries.end(); }
+
+        /**
+         * Find the map containing an address
+         * @return The entry, or nullptr if the address is not mapped
+         */
+        const Entry* find(uintptr_t address) const;
+
+        /**
+         * Check if a whole address range is mapped (possibly across adjacent maps) with permissions
+         * @param address Absolute start of the range
+         * @param size Size of the range in bytes
+         * @param perms PERM_* bits every map covering the range must have (0 for any)
+         */
+        bool contains(uintptr_t address, size_t size = 1, uint8_t perms = 0) const;
+
+        /** Get all entries that have every PERM_* bit in a mask */
+        std::vector<const Entry*> filter(uint8_t perms) const;
+
+        /** Copy an entry into a standalone Map */
+        inline Map toMap(const Entry& entry) const { return entry.map.toMap(pid()); }
+    };
+} // namespace fatigue::proc
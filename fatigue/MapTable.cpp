@@ -0,0 +1,131 @@
+#include <charconv>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <format>
+#include <unistd.h>
+#include "log.hpp"
+#include "MapTable.hpp"
+
+namespace fatigue::proc {
+
+    namespace {
+        /** Starting buffer size, enough for a few hundred maps; grown as needed */
+        const size_t s_initialBufferSize = 64 * 1024;
+
+        /** Take the next field up to a space, and skip the spaces after it */
+        std::string_view field(std::string_view& line)
+        {
+            size_t space = line.find(' ');
+            std::string_view value = line.substr(0, space);
+            line.remove_prefix(space == std::string_view::npos ? line.size() : space);
+            while (!line.empty() && line.front() == ' ') line.remove_prefix(1);
+            return value;
+        }
+
+        template <typename T>
+        bool number(std::string_view text, T& value, int base)
+        {
+            auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value, base);
+            return error == std::errc{} && end == text.data() + text.size();
+        }
+    } // namespace
+
+    // MapEntry
+
+    Map MapEntry::toMap(pid_t pid) const
+    {
+        return Map(pid, start, end, std::string(perms), offset, std::string(dev), inode, std::string(name));
+    }
+
+    // MapTable
+
+    MapTable::MapTable(pid_t pid)
+    {
+        load(pid);
+    }
+
+    bool MapTable::load(pid_t pid)
+    {
+        m_pid = pid;
+        m_size = 0;
+        if (pid <= 0) return false;
+
+        char path[32];
+        snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            logError(std::format("Error opening {}: {}", path, strerror(errno)));
+            return false;
+        }
+
+        // The file has no size up front, keep reading (and growing) until the end
+        if (m_buffer.empty()) m_buffer.resize(s_initialBufferSize);
+
+        bool ok = true;
+        while (true) {
+            if (m_size == m_buffer.size()) m_buffer.resize(m_buffer.size() * 2);
+
+            ssize_t bytesRead = ::read(fd, m_buffer.data() + m_size, m_buffer.size() - m_size);
+            if (bytesRead < 0 && errno == EINTR) continue;
+            if (bytesRead < 0) {
+                logError(std::format("Error reading {}: {}", path, strerror(errno)));
+                ok = false;
+                m_size = 0;
+            }
+            if (bytesRead <= 0) break;
+
+            m_size += bytesRead;
+        }
+
+        close(fd);
+        return ok;
+    }
+
+    bool MapTable::parse(std::string_view line, MapEntry& entry)
+    {
+        // (format) start-end perms offset dev inode [pathname, may contain spaces]
+        std::string_view range = field(line);
+        size_t dash = range.find('-');
+        if (dash == std::string_view::npos) return false;
+        if (!number(range.substr(0, dash), entry.start, 16)) return false;
+        if (!number(range.substr(dash + 1), entry.end, 16)) return false;
+
+        entry.perms = field(line);
+        if (entry.perms.size() < 4) return false;
+
+        if (!number(field(line), entry.offset, 16)) return false;
+        entry.dev = field(line);
+        if (!number(field(line), entry.inode, 10)) return false;
+
+        // Whatever is left is the name (leading padding was skipped with the inode)
+        while (!line.empty() && (line.back() == ' ' || line.back() == '\r')) line.remove_suffix(1);
+        entry.name = line;
+
+        return true;
+    }
+
+    // MapTable::iterator
+
+    MapTable::iterator::iterator(const char* begin, const char* end) : m_next(begin), m_end(end), m_done(false)
+    {
+        parse();
+    }
+
+    void MapTable::iterator::parse()
+    {
+        while (m_next && m_next < m_end) {
+            const char* newline = static_cast<const char*>(memchr(m_next, '\n', m_end - m_next));
+            const char* lineEnd = newline ? newline : m_end;
+
+            std::string_view line(m_next, lineEnd - m_next);
+            m_next = newline ? newline + 1 : m_end;
+
+            if (MapTable::parse(line, m_entry)) return;
+        }
+
+        m_done = true;
+        m_entry = {};
+    }
+} // namespace fatigue::proc
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include <sys/types.h>
+#include <vector>
+#include "proc.hpp"
+
+namespace fatigue::proc {
+    /**
+     * @brief One line of /proc/[pid]/maps, without copies
+     * Text fields are slices of the MapTable buffer they were parsed from, so an entry is only
+     * valid as long as that table is alive and not reloaded. Use toMap() to keep one around.
+     */
+    struct MapEntry {
+        uintptr_t start{0};
+        uintptr_t end{0};
+        std::string_view perms{};
+        unsigned long long offset{0};
+        std::string_view dev{};
+        unsigned long inode{0};
+        std::string_view name{};
+
+        inline size_t size() const { return end - start; }
+        inline bool isValid() const { return end > start; }
+        inline bool contains(uintptr_t address) const { return address >= start && address < end; }
+
+        inline bool isRead() const { return perms.size() > 0 && perms[0] == 'r'; }
+        inline bool isWrite() const { return perms.size() > 1 && perms[1] == 'w'; }
+        inline bool isExec() const { return perms.size() > 2 && perms[2] == 'x'; }
+        inline bool isPrivate() const { return perms.size() > 3 && perms[3] == 'p'; }
+        inline bool isShared() const { return perms.size() > 3 && perms[3] == 's'; }
+
+        inline bool isAnonymous() const { return name.empty(); }
+        inline bool isPsuedo() const { return !name.empty() && name.front() == '['; }
+        inline bool isFile() const { return !isAnonymous() && !isPsuedo(); }
+
+        /** Copy the entry into a standalone Map for a process */
+        Map toMap(pid_t pid) const;
+    };
+
+    /**
+     * @brief Raw contents of /proc/[pid]/maps with lazy, allocation free parsing
+     * The file is read with a few read() calls into one buffer owned by the table (reused by
+     * reload()), and lines are only parsed as they are iterated, so a search can stop at the
+     * first hit without building every Map. Names keep their spaces (e.g. Wine paths).
+     */
+    class MapTable {
+    protected:
+        pid_t m_pid{0};
+        std::vector<char> m_buffer{};
+        size_t m_size{0};
+
+    public:
+        /** Forward iterator parsing one line per step; malformed lines are skipped */
+        class iterator {
+        protected:
+            const char* m_next{nullptr};
+            const char* m_end{nullptr};
+            MapEntry m_entry{};
+            bool m_done{true};
+
+            void parse();
+
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = MapEntry;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const MapEntry*;
+            using reference = const MapEntry&;
+
+            iterator() = default;
+            iterator(const char* begin, const char* end);
+
+            inline reference operator*() const { return m_entry; }
+            inline pointer operator->() const { return &m_entry; }
+            inline iterator& operator++() { parse(); return *this; }
+            inline iterator operator++(int) { iterator previous = *this; parse(); return previous; }
+
+            /** Iterators only compare by position (any two finished iterators are equal) */
+            inline bool operator==(const iterator& other) const
+            {
+                return m_done == other.m_done && (m_done || m_next == other.m_next);
+            }
+        };
+
+        MapTable() = default;
+        /** Read the maps of a process (see load()) */
+        explicit MapTable(pid_t pid);
+        ~MapTable() = default;
+
+        // Entries point into the buffer; a move keeps the heap buffer, a copy would not
+        MapTable(const MapTable&) = delete;
+        MapTable& operator=(const MapTable&) = delete;
+        MapTable(MapTable&&) = default;
+        MapTable& operator=(MapTable&&) = default;
+
+        /**
+         * Read /proc/[pid]/maps into the buffer, replacing the previous contents
+         * Entries from before the call are no longer valid.
+         * @return false if the file could not be read
+         */
+        bool load(pid_t pid);
+        /** Read the maps of the same process again */
+        inline bool reload() { return load(m_pid); }
+
+        inline pid_t pid() const { return m_pid; }
+        /** Raw file contents */
+        inline std::string_view text() const { return {m_buffer.data(), m_size}; }
+        inline bool empty() const { return m_size == 0; }
+
+        inline iterator begin() const { return {m_buffer.data(), m_buffer.data() + m_size}; }
+        inline iterator end() const { return {}; }
+
+        /**
+         * Parse a single maps line (without the trailing newline)
+         * @return false if the line is malformed
+         */
+        static bool parse(std::string_view line, MapEntry& entry);
+    };
+} // namespace fatigue::proc
@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <cstring>
+#include "MapWatcher.hpp"
+
+namespace fatigue::proc {
+
+    namespace {
+        /** FNV-1a, plenty for telling maps lines apart */
+        uint64_t hashLine(std::string_view text)
+        {
+            uint64_t hash = 0xcbf29ce484222325ULL;
+            for (char c : text) {
+                hash ^= static_cast<uint8_t>(c);
+                hash *= 0x100000001b3ULL;
+            }
+            return hash;
+        }
+    } // namespace
+
+    void MapWatcher::index(const MapTable& table, std::vector<Line>& lines)
+    {
+        lines.clear();
+        std::string_view text = table.text();
+
+        while (!text.empty()) {
+            size_t newline = text.find('\n');
+            std::string_view line = text.substr(0, newline);
+            text.remove_prefix(newline == std::string_view::npos ? text.size() : newline + 1);
+
+            if (!line.empty()) lines.push_back({line, hashLine(line)});
+        }
+    }
+
+    std::vector<MapEvent> MapWatcher::poll()
+    {
+        std::vector<MapEvent> events;
+
+        size_t previous = m_current;
+        size_t next = m_current ^ 1;
+        if (!m_tables[next].load(m_pid)) return events;
+
+        // Cheapest check first: the whole file is byte for byte the same
+        if (m_loaded && m_tables[next].text() == m_tables[previous].text()) return events;
+
+        index(m_tables[next], m_lines[next]);
+        m_current = next;
+
+        if (!m_loaded) m_lines[previous].clear();
+        const std::vector<Line>& before = m_lines[previous];
+        const std::vector<Line>& after = m_lines[next];
+        m_loaded = true;
+
+        // Skip the unchanged prefix and suffix (the kernel lists maps in address order)
+        size_t prefix = 0;
+        size_t limit = std::min(before.size(), after.size());
+        while (prefix < limit && before.at(prefix).hash == after.at(prefix).hash) prefix++;
+
+        size_t suffix = 0;
+        while (suffix < limit - prefix &&
+               before.at(before.size() - 1 - suffix).hash == after.at(after.size() - 1 - suffix).hash) {
+            suffix++;
+        }
+
+        // Walk what is left of both sides in step, matching maps by start address
+        size_t b = prefix;
+        size_t a = prefix;
+        size_t beforeEnd = before.size() - suffix;
+        size_t afterEnd = after.size() - suffix;
+        MapEntry oldEntry;
+        MapEntry newEntry;
+
+        while (b < beforeEnd || a < afterEnd) {
+            bool hasOld = b < beforeEnd && MapTable::parse(before.at(b).text, oldEntry);
+            bool hasNew = a < afterEnd && MapTable::parse(after.at(a).text, newEntry);
+
+            // Malformed lines are skipped, like MapTable iteration does
+            if (b < beforeEnd && !hasOld) { b++; continue; }
+            if (a < afterEnd && !hasNew) { a++; continue; }
+
+            if (hasOld && (!hasNew || oldEntry.start < newEntry.start)) {
+                events.push_back({.type = MapEvent::Type::Removed, .before = oldEntry});
+                b++;
+            } else if (hasNew && (!hasOld || newEntry.start < oldEntry.start)) {
+                events.push_back({.type = MapEvent::Type::Added, .after = newEntry});
+                a++;
+            } else {
+                if (before.at(b).hash != after.at(a).hash) {
+                    events.push_back({.type = MapEvent::Type::Changed, .before = oldEntry, .after = newEntry});
+                }
+                b++;
+                a++;
+            }
+        }
+
+        if (events.empty()) return events;
+        m_generation++;
+
+        // Listeners may subscribe or unsubscribe while being called
+        std::vector<Subscription> subscriptions = m_subscriptions;
+        for (const MapEvent& event : events) {
+            for (const Subscription& subscription : subscriptions) {
+                if (event.overlaps(subscription.start, subscription.end)) subscription.listener(event);
+            }
+        }
+
+        return events;
+    }
+
+    size_t MapWatcher::subscribe(Listener listener, uintptr_t start, uintptr_t end)
+    {
+        if (!listener) return 0;
+
+        size_t id = m_nextId++;
+        m_subscriptions.push_back({id, start, end, std::move(listener)});
+        return id;
+    }
+
+    void MapWatcher::unsubscribe(size_t id)
+    {
+        std::erase_if(m_subscriptions, [id](const Subscription& subscription) { return subscription.id == id; });
+    }
+} // namespace fatigue::proc
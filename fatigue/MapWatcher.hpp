@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <sys/types.h>
+#include <vector>
+#include "MapTable.hpp"
+
+namespace fatigue::proc {
+    /** A difference between two reads of a process' maps */
+    struct MapEvent {
+        enum class Type {
+            Added,
+            Removed,
+            /** Same start address, but anything else on the line changed (end, perms, offset, file) */
+            Changed
+        };
+
+        Type type{Type::Added};
+        /** Map as it was (Removed, Changed) */
+        MapEntry before{};
+        /** Map as it is now (Added, Changed) */
+        MapEntry after{};
+
+        /** Check if the event touches an absolute address range, before or after the change */
+        inline bool overlaps(uintptr_t start, uintptr_t end) const
+        {
+            return (before.isValid() && before.start < end && before.end > start) ||
+                   (after.isValid() && after.start < end && after.end > start);
+        }
+    };
+
+    /**
+     * @brief Follow changes to a process' maps between polls
+     * Each poll() reads /proc/[pid]/maps into one of two alternating MapTables, so the previous
+     * read stays available for the diff without copying anything. Unchanged files are detected
+     * with a single compare; otherwise lines are hashed, the common prefix and suffix are skipped,
+     * and only the lines in between are parsed and matched by start address.
+     * Listeners can subscribe to an address range (e.g. a section Region) and are only called
+     * when a map overlapping it is added, removed, or changed, which is when caches built on
+     * that memory (snapshots, section regions, resolved pointers) need to be invalidated.
+     */
+    class MapWatcher {
+    public:
+        using Listener = std::function<void(const MapEvent&)>;
+
+    protected:
+        struct Line {
+            std::string_view text;
+            uint64_t hash;
+        };
+
+        struct Subscription {
+            size_t id;
+            uintptr_t start;
+            uintptr_t end;
+            Listener listener;
+        };
+
+        pid_t m_pid{0};
+        /** Alternating reads, m_tables[m_current] is the latest */
+        MapTable m_tables[2]{};
+        std::vector<Line> m_lines[2]{};
+        size_t m_current{0};
+        bool m_loaded{false};
+        uint64_t m_generation{0};
+
+        std::vector<Subscription> m_subscriptions{};
+        size_t m_nextId{1};
+
+        /** Split a table into lines and hash them */
+        static void index(const MapTable& table, std::vector<Line>& lines);
+
+    public:
+        explicit MapWatcher(pid_t pid) : m_pid(pid) {}
+        ~MapWatcher() = default;
+
+        // Events and tables point into the alternating buffers
+        MapWatcher(const MapWatcher&) = delete;
+        MapWatcher& operator=(const MapWatcher&) = delete;
+
+        inline pid_t pid() const { return m_pid; }
+        /** Latest read of the maps (empty before the first poll) */
+        inline const MapTable& maps() const { return m_tables[m_current]; }
+        /** Incremented by every poll that found a change */
+        inline uint64_t generation() const { return m_generation; }
+
+        /**
+         * Read the maps again and report what changed since the previous poll
+         * The first poll reports every map as added. Events (and their entries) stay valid until
+         * the next poll. Matching listeners are called before this returns.
+         * @return Changes in address order, empty if nothing changed or the maps could not be read
+         */
+        std::vector<MapEvent> poll();
+
+        /**
+         * Call a listener for every change that touches an absolute address range
+         * @return Id to unsubscribe with
+         */
+        size_t subscribe(Listener listener, uintptr_t start = 0, uintptr_t end = UINTPTR_MAX);
+        /** Stop calling a listener */
+        void unsubscribe(size_t id);
+    };
+} // namespace fatigue::proc
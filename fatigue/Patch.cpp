@@ -1,4 +1,5 @@
 #include "Patch.hpp"
+#include "SignatureCache.hpp"
 
 namespace fatigue {
     // Setup
@@ -23,7 +24,11 @@ namespace fatigue {
 
         // Backup matched data and original data
         backup();
+        checkBackup();
+    }
 
+    void Patch::checkBackup() const
+    {
         // Quick consistency check
         if (m_matched.size() != patternSize()) {
             logWarning(std::format(
@@ -51,37 +56,26 @@ namespace fatigue {
     {
         m_address = 0;
         m_found = false;
+        m_cached = false;
 
         if (m_region.isValid()) {
-            m_matches = m_region.find(m_pattern);
-            m_found = !m_matches.empty();
-            if (m_found) {
-                m_address = m_matches.front();
-            } else {
-                logWarning(std::format(
-                    "Patch failed to find pattern:\n"
-                    "  Region: {}\n"
-                    "  Pattern: {}",
-                    m_region.toString(), m_pattern
-                ));
-            }
-
-            if (m_matches.size() > 1) {
-                std::string show = "";
-                for (size_t i = 1; i < defaultShowMatches && i < m_matches.size(); i++) {
-                    show += std::format("{:#x}, ", m_matches.at(i));
+            // Try the cached match first, checking it costs one read of the pattern size
+            std::shared_ptr<SignatureCache> cache = s_signatureCache;
+            uintptr_t cachedAddress = 0;
+            if (cache && cache->lookup(m_pattern, m_region, cachedAddress)) {
+                if (matchesAt(cachedAddress)) {
+                    m_matches = {cachedAddress};
+                    m_address = cachedAddress;
+                    m_found = true;
+                    m_cached = true;
+                    return;
                 }
-
-                logWarning(std::format(
-                    "Patch found {} matches for pattern (pattern may be too loose):\n"
-                    "  Region: {}\n"
-                    "  Pattern: {}\n"
-                    "  Using first match at {:#x}\n"
-                    "  Also matched at {}{}",
-                    m_matches.size(), m_region.toString(), m_pattern, m_address,
-                    show, (m_matches.size() > defaultShowMatches ? "..." : "")
-                ));
+                logDebug(std::format("Cached match at {:#x} is stale, scanning for pattern {}", cachedAddress, m_pattern));
+                cache->erase(m_pattern);
             }
+
+            setMatches(m_region.find(m_pattern));
+            if (m_found && cache) cache->store(m_pattern, m_region, m_address);
         } else {
             logWarning(std::format(
                 "Patch region is invalid:\n"
@@ -92,6 +86,52 @@ namespace fatigue {
         }
     }
 
+    void Patch::setMatches(const std::vector<uintptr_t>& matches)
+    {
+        m_matches = matches;
+        m_found = !m_matches.empty();
+        if (m_found) {
+            m_address = m_matches.front();
+        } else {
+            logWarning(std::format(
+                "Patch failed to find pattern:\n"
+                "  Region: {}\n"
+                "  Pattern: {}",
+                m_region.toString(), m_pattern
+            ));
+        }
+
+        if (m_matches.size() > 1) {
+            std::string show = "";
+            for (size_t i = 1; i < defaultShowMatches && i < m_matches.size(); i++) {
+                show += std::format("{:#x}, ", m_matches.at(i));
+            }
+
+            logWarning(std::format(
+                "Patch found {} matches for pattern (pattern may be too loose):\n"
+                "  Region: {}\n"
+                "  Pattern: {}\n"
+                "  Using first match at {:#x}\n"
+                "  Also matched at {}{}",
+                m_matches.size(), m_region.toString(), m_pattern, m_address,
+                show, (m_matches.size() > defaultShowMatches ? "..." : "")
+            ));
+        }
+    }
+
+    bool Patch::matchesAt(uintptr_t address) const
+    {
+        search::Pattern pattern = search::parsePattern(m_pattern);
+        if (pattern.bytes.empty() || address + pattern.bytes.size() > m_region.size()) return false;
+
+        std::vector<uint8_t> data(pattern.bytes.size());
+        mem::ReadRequest request{.address = address, .buffer = data.data(), .size = data.size()};
+        if (m_region.readMany({&request, 1}) != 1) return false;
+
+        auto found = search::search(data.data(), data.size(), pattern, true);
+        return !found.empty() && found.front() == 0;
+    }
+
     void Patch::backup()
     {
         if (!isValid()) return;
@@ -234,7 +274,7 @@ namespace fatigue {
                     << std::format("{:{}s}", "", labelWidth)
                     << std::format("Using first match at {:#x}", m_address);
             } else {
-                out << Color::BrightBlue << "Found ✔" << Color::Reset;
+                out << Color::BrightBlue << (m_cached ? "Found (cached) ✔" : "Found ✔") << Color::Reset;
             }
             out << std::endl;
 
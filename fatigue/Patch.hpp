@@ -5,13 +5,19 @@
 #include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <vector>
 #include "log.hpp"
 #include "Region.hpp"
 #include "utils.hpp"
 
 namespace fatigue {
+    class PatchSet;
+    class SignatureCache;
+
     class Patch {
+        friend class PatchSet;
+
     protected:
         /** Character width of the first colomn in dump outputs */
         static const size_t labelWidth = sizeof(unsigned long long) + 4; // Max address width + "0x" + ": "
@@ -31,6 +37,17 @@ namespace fatigue {
 
         bool m_found{false};
         bool m_applied{false};
+        /** True if the address came from the signature cache instead of a scan */
+        bool m_cached{false};
+
+        /** Cache consulted by find(), shared by all patches (@see setSignatureCache) */
+        inline static std::shared_ptr<SignatureCache> s_signatureCache{nullptr};
+        /** Check if the pattern matches at an offset in the region */
+        bool matchesAt(uintptr_t address) const;
+        /** Use the first of the matches of the pattern, warning if there are none or several */
+        void setMatches(const std::vector<uintptr_t>& matches);
+        /** Warn if the backed up data does not fit the pattern and patch */
+        void checkBackup() const;
 
         /** Not used internally, but can be used to debug multiple matches */
         std::vector<uintptr_t> m_matches{};
@@ -92,8 +109,17 @@ namespace fatigue {
         inline std::vector<uint8_t> original() const { return m_original; }
         inline bool found() const { return m_found; }
         inline bool applied() const { return m_applied; }
+        inline bool cached() const { return m_cached; }
         inline std::vector<uintptr_t> matches() const { return m_matches; }
 
+        /**
+         * @brief Use a signature cache for patches found after this call (nullptr to stop)
+         * Patterns found in a region covered by the cache are remembered, and later finds only
+         * verify the bytes at the remembered address instead of scanning the whole region.
+         */
+        static inline void setSignatureCache(std::shared_ptr<SignatureCache> cache) { s_signatureCache = cache; }
+        static inline std::shared_ptr<SignatureCache> getSignatureCache() { return s_signatureCache; }
+
         bool isValid() const { return m_region.isValid() && m_found; }
         size_t patternSize() const { return hex::split(m_pattern).size(); }
         uintptr_t patchAddress() const { return m_address + offset(); }
@@ -0,0 +1,330 @@
+#include <algorithm>
+#include <span>
+#include <sstream>
+#include "PatchSet.hpp"
+#include "SignatureCache.hpp"
+
+namespace fatigue {
+
+    namespace {
+        inline bool sameRegion(const Region& a, const Region& b)
+        {
+            return a.pid == b.pid && a.start == b.start && a.end == b.end && a.method == b.method;
+        }
+    } // namespace
+
+    // Members
+
+    size_t PatchSet::add(Patch&& patch, search::Pattern&& compiled)
+    {
+        m_resolved = false;
+        m_patches.push_back(std::move(patch));
+        m_compiled.push_back(std::move(compiled));
+        return m_patches.size() - 1;
+    }
+
+    const search::Pattern& PatchSet::compiled(size_t index)
+    {
+        search::Pattern& pattern = m_compiled.at(index);
+        const Patch& patch = m_patches.at(index);
+        if (pattern.bytes.empty() && !patch.m_pattern.empty()) pattern = search::parsePattern(patch.m_pattern);
+        return pattern;
+    }
+
+    size_t PatchSet::add(const Region& region, uintptr_t address, const std::vector<uint8_t>& patch)
+    {
+        Patch member;
+        member.m_region = region;
+        member.m_address = address;
+        member.m_patch = patch;
+        return add(std::move(member));
+    }
+
+    size_t PatchSet::add(const Region& region, const std::string& pattern, int offset, const std::vector<uint8_t>& patch)
+    {
+        Patch member;
+        member.m_region = region;
+        member.m_pattern = pattern;
+        member.m_offset = offset;
+        member.m_patch = patch;
+        return add(std::move(member));
+    }
+
+    size_t PatchSet::add(const Region& region, const std::string& pattern, std::function<int(Patch const&)> offset_fn, const std::vector<uint8_t>& patch)
+    {
+        Patch member;
+        member.m_region = region;
+        member.m_pattern = pattern;
+        member.m_offset_fn = offset_fn;
+        member.m_patch = patch;
+        return add(std::move(member));
+    }
+
+    size_t PatchSet::add(const Region& region, const std::string& pattern, const search::Pattern& compiled, int offset, const std::vector<uint8_t>& patch)
+    {
+        Patch member;
+        member.m_region = region;
+        member.m_pattern = pattern;
+        member.m_offset = offset;
+        member.m_patch = patch;
+        return add(std::move(member), search::Pattern(compiled));
+    }
+
+    size_t PatchSet::add(const Region& region, const std::string& pattern, const search::Pattern& compiled, std::function<int(Patch const&)> offset_fn, const std::vector<uint8_t>& patch)
+    {
+        Patch member;
+        member.m_region = region;
+        member.m_pattern = pattern;
+        member.m_offset_fn = offset_fn;
+        member.m_patch = patch;
+        return add(std::move(member), search::Pattern(compiled));
+    }
+
+    bool PatchSet::isValid() const
+    {
+        if (m_patches.empty()) return false;
+
+        for (const Patch& patch : m_patches) {
+            if (!patch.isValid() || patch.m_patch.empty() || patch.m_original.size() != patch.m_patch.size()) return false;
+        }
+        return true;
+    }
+
+    // Actions
+
+    bool PatchSet::resolve()
+    {
+        if (m_applied) {
+            logWarning("Cannot resolve, patch set is applied");
+            return false;
+        }
+
+        // Group the patches by region, so each region is scanned and read only once
+        std::vector<std::vector<size_t>> groups;
+        for (size_t i = 0; i < m_patches.size(); i++) {
+            Patch& patch = m_patches.at(i);
+            patch.m_found = patch.m_pattern.empty() && patch.m_region.isValid();
+            patch.m_cached = false;
+            patch.m_matches.clear();
+            patch.m_matched.clear();
+            patch.m_original.clear();
+            if (!patch.m_pattern.empty()) patch.m_address = 0;
+
+            auto group = std::find_if(groups.begin(), groups.end(), [&](const std::vector<size_t>& members) {
+                return sameRegion(m_patches.at(members.front()).m_region, patch.m_region);
+            });
+            if (group == groups.end()) {
+                groups.push_back({i});
+            } else {
+                group->push_back(i);
+            }
+        }
+
+        std::shared_ptr<SignatureCache> cache = Patch::s_signatureCache;
+
+        for (const std::vector<size_t>& members : groups) {
+            const Region& region = m_patches.at(members.front()).m_region;
+            if (!region.isValid()) {
+                logWarning(std::format("Patch region is invalid: {}", region.toString()));
+                continue;
+            }
+
+            // Cached matches first, all verified with one batched read
+            std::vector<size_t> scan;
+            std::vector<size_t> cached;
+            std::vector<std::vector<uint8_t>> data;
+            std::vector<mem::ReadRequest> requests;
+
+            for (size_t index : members) {
+                Patch& patch = m_patches.at(index);
+                if (patch.m_pattern.empty()) continue;
+
+                const search::Pattern& pattern = compiled(index);
+                uintptr_t address = 0;
+                if (cache && !pattern.bytes.empty() && cache->lookup(patch.m_pattern, region, address)
+                    && address + pattern.bytes.size() <= region.size()) {
+                    patch.m_address = address;
+                    cached.push_back(index);
+                    data.emplace_back(pattern.bytes.size());
+                } else {
+                    scan.push_back(index);
+                }
+            }
+
+            for (size_t i = 0; i < cached.size(); i++) {
+                requests.push_back({.address = m_patches.at(cached.at(i)).m_address, .buffer = data.at(i).data(), .size = data.at(i).size()});
+            }
+            if (!requests.empty()) region.readMany(requests);
+
+            for (size_t i = 0; i < cached.size(); i++) {
+                Patch& patch = m_patches.at(cached.at(i));
+                auto found = requests.at(i).complete()
+                    ? search::search(data.at(i).data(), data.at(i).size(), compiled(cached.at(i)), true)
+                    : std::vector<uintptr_t>{};
+
+                if (!found.empty() && found.front() == 0) {
+                    patch.m_matches = {patch.m_address};
+                    patch.m_found = true;
+                    patch.m_cached = true;
+                } else {
+                    logDebug(std::format("Cached match at {:#x} is stale, scanning for pattern {}", patch.m_address, patch.m_pattern));
+                    cache->erase(patch.m_pattern);
+                    patch.m_address = 0;
+                    scan.push_back(cached.at(i));
+                }
+            }
+
+            // Everything else in a single pass over the region
+            if (!scan.empty()) {
+                std::vector<search::Pattern> pending;
+                for (size_t index : scan) pending.push_back(compiled(index));
+
+                std::vector<std::vector<uintptr_t>> matches = region.findAll(pending);
+                for (size_t i = 0; i < scan.size(); i++) {
+                    Patch& patch = m_patches.at(scan.at(i));
+                    patch.setMatches(matches.at(i));
+                    if (patch.m_found && cache) cache->store(patch.m_pattern, region, patch.m_address);
+                }
+            }
+
+            // Back up the matched and original data of every patch with one batched read (two if some
+            // patches write outside the region, e.g. the target of a rel32, and must be read unbounded)
+            requests.clear();
+            std::vector<size_t> owners;
+            size_t bounded = 0;
+            for (bool enforced : {true, false}) {
+                for (size_t index : members) {
+                    Patch& patch = m_patches.at(index);
+                    if (!patch.m_found || patch.m_region.enforceBounds != enforced) continue;
+
+                    if (!patch.m_pattern.empty()) {
+                        patch.m_matched.resize(compiled(index).bytes.size());
+                        requests.push_back({.address = patch.m_address, .buffer = patch.m_matched.data(), .size = patch.m_matched.size()});
+                        owners.push_back(index);
+                    }
+                    patch.m_original.resize(patch.m_patch.size());
+                    requests.push_back({.address = patch.patchAddress(), .buffer = patch.m_original.data(), .size = patch.m_original.size()});
+                    owners.push_back(index);
+                }
+                if (enforced) bounded = requests.size();
+            }
+
+            std::span<mem::ReadRequest> batch(requests);
+            Region enforced = region;
+            Region unbounded = region;
+            enforced.enforceBounds = true;
+            unbounded.enforceBounds = false;
+            if (bounded > 0) enforced.readMany(batch.first(bounded));
+            if (bounded < batch.size()) unbounded.readMany(batch.subspan(bounded));
+
+            for (size_t i = 0; i < requests.size(); i++) {
+                const mem::ReadRequest& request = requests.at(i);
+                if (request.complete()) continue;
+
+                // Like Patch::backup(), keep what could be read; the size check below reports it
+                Patch& patch = m_patches.at(owners.at(i));
+                std::vector<uint8_t>& buffer = request.buffer == patch.m_matched.data() ? patch.m_matched : patch.m_original;
+                buffer.resize(request.bytesRead);
+            }
+
+            for (size_t index : members) {
+                if (m_patches.at(index).m_found) m_patches.at(index).checkBackup();
+            }
+        }
+
+        m_resolved = true;
+        return isValid();
+    }
+
+    bool PatchSet::write(bool applying)
+    {
+        size_t written = 0;
+        bool failed = false;
+
+        for (; written < m_patches.size(); written++) {
+            Patch& patch = m_patches.at(written);
+            const std::vector<uint8_t>& data = applying ? patch.m_patch : patch.m_original;
+
+            try {
+                if (patch.m_region.write(patch.patchAddress(), data.data(), data.size()) != static_cast<ssize_t>(data.size())) {
+                    failed = true;
+                }
+            } catch (const std::exception& error) {
+                logDebug(error.what());
+                failed = true;
+            }
+
+            if (failed) {
+                logWarning(std::format("Failed to write {} data at {:#x} in {}",
+                    applying ? "patch" : "original", patch.patchAddress(), patch.m_region.toString()));
+                break;
+            }
+            patch.m_applied = applying;
+        }
+
+        if (!failed) {
+            m_applied = applying;
+            return true;
+        }
+
+        // Undo what was written, newest first, starting with the failed patch: a short write or an
+        // exception may have left part of it in place
+        for (size_t i = written + 1; i-- > 0;) {
+            Patch& patch = m_patches.at(i);
+            const std::vector<uint8_t>& data = applying ? patch.m_original : patch.m_patch;
+
+            try {
+                bool restored = patch.m_region.write(patch.patchAddress(), data.data(), data.size()) == static_cast<ssize_t>(data.size());
+                if (!restored && i == written) {
+                    // The rest of the failed patch may not be writable, it is enough if it reads as before
+                    std::vector<uint8_t> current(data.size());
+                    restored = patch.m_region.read(patch.patchAddress(), current.data(), current.size()) == static_cast<ssize_t>(current.size())
+                        && current == data;
+                }
+                if (restored) {
+                    patch.m_applied = !applying;
+                    continue;
+                }
+            } catch (const std::exception& error) {
+                logDebug(error.what());
+            }
+            logError(std::format("Failed to roll back patch at {:#x} in {}", patch.patchAddress(), patch.m_region.toString()));
+        }
+
+        return false;
+    }
+
+    bool PatchSet::apply()
+    {
+        if (m_applied) return true;
+        if (!m_resolved) resolve();
+
+        if (!isValid()) {
+            logWarning("Cannot apply, not every patch in the set was found and backed up");
+            return false;
+        }
+
+        return write(true);
+    }
+
+    bool PatchSet::restore()
+    {
+        if (!m_applied) return true;
+
+        if (!isValid()) {
+            logWarning("Cannot restore, original data is missing");
+            return false;
+        }
+
+        return write(false);
+    }
+
+    std::string PatchSet::dump() const
+    {
+        std::stringstream out;
+        for (const Patch& patch : m_patches) {
+            out << patch.dump() << std::endl;
+        }
+        return out.str();
+    }
+} // namespace fatigue
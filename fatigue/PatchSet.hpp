@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "Patch.hpp"
+#include "Region.hpp"
+
+namespace fatigue {
+    /**
+     * @brief Patches that are applied and restored together, or not at all
+     * Patches are added without touching the process. resolve() then finds every pattern with one
+     * pass per region (all patterns of a region go into a single MultiPattern scan, after checking
+     * the signature cache), and backs up the matched and original data of every patch with one
+     * batched read per region. apply() writes all patches in one pass; if any write fails, the
+     * patches already written are restored in reverse order, so the process is never left half
+     * patched.
+     */
+    class PatchSet {
+    protected:
+        std::vector<Patch> m_patches{};
+        /** Parsed pattern of each patch, parsed on first use if not given to add() */
+        std::vector<search::Pattern> m_compiled{};
+        bool m_resolved{false};
+        bool m_applied{false};
+
+        /** Add a patch that has not been initialized, returns its index */
+        size_t add(Patch&& patch, search::Pattern&& compiled = {});
+        /** Get the parsed pattern of a patch, parsing it if needed */
+        const search::Pattern& compiled(size_t index);
+        /** Write the patch data (or the original data) of every patch, undoing the writes on failure */
+        bool write(bool applying);
+
+    public:
+        PatchSet() = default;
+        ~PatchSet() = default;
+
+        // Members (nothing is read until resolve())
+
+        /** @brief Add a patch at a known offset in a region, returns its index */
+        size_t add(const Region& region, uintptr_t address, const std::vector<uint8_t>& patch);
+        /** @brief Add a patch at a known offset in a region with a patch hex string */
+        inline size_t add(const Region& region, uintptr_t address, const std::string& patch)
+        {
+            return add(region, address, hex::parse(patch));
+        }
+
+        /** @brief Add a patch found by pattern, at an offset from the match */
+        size_t add(const Region& region, const std::string& pattern, int offset, const std::vector<uint8_t>& patch);
+        /** @brief Add a patch found by pattern with a patch hex string */
+        inline size_t add(const Region& region, const std::string& pattern, int offset, const std::string& patch)
+        {
+            return add(region, pattern, offset, hex::parse(patch));
+        }
+        /** @brief Add a patch found by pattern with a patch data chunk */
+        inline size_t add(const Region& region, const std::string& pattern, int offset, const void* patch, size_t size)
+        {
+            return add(region, pattern, offset, hex::parse(patch, size));
+        }
+
+        /**
+         * @brief Add a patch found by an already parsed pattern (e.g. from a Manifest), skips parsing on resolve
+         * @param pattern Pattern string, still used as the signature cache key and for dumps
+         */
+        size_t add(const Region& region, const std::string& pattern, const search::Pattern& compiled, int offset, const std::vector<uint8_t>& patch);
+
+        /**
+         * @brief Add a patch found by pattern, at an offset computed once the pattern is found
+         * The offset function is called after the whole set is resolved, and may read from the region
+         */
+        size_t add(const Region& region, const std::string& pattern, std::function<int(Patch const&)> offset_fn, const std::vector<uint8_t>& patch);
+        /** @brief Add a patch found by an already parsed pattern, at a computed offset */
+        size_t add(const Region& region, const std::string& pattern, const search::Pattern& compiled, std::function<int(Patch const&)> offset_fn, const std::vector<uint8_t>& patch);
+        /** @brief Add a patch found by pattern at a computed offset, with a patch data chunk */
+        inline size_t add(const Region& region, const std::string& pattern, std::function<int(Patch const&)> offset_fn, const void* patch, size_t size)
+        {
+            return add(region, pattern, offset_fn, hex::parse(patch, size));
+        }
+
+        // Accessors
+
+        inline size_t size() const { return m_patches.size(); }
+        inline bool empty() const { return m_patches.empty(); }
+        inline const Patch& at(size_t index) const { return m_patches.at(index); }
+        inline const std::vector<Patch>& patches() const { return m_patches; }
+        inline bool resolved() const { return m_resolved; }
+        inline bool applied() const { return m_applied; }
+
+        /** Check if every patch was found and backed up */
+        bool isValid() const;
+
+        // Actions
+
+        /**
+         * @brief Find every pattern and back up every patch
+         * @return true if every patch was found and backed up (@see isValid)
+         */
+        bool resolve();
+
+        /**
+         * @brief Apply every patch, resolving first if needed
+         * @return true if every patch was applied; on false, nothing is left applied
+         */
+        bool apply();
+
+        /**
+         * @brief Restore the original data of every patch
+         * @return true if every patch was restored; on false, the patches are left applied
+         */
+        bool restore();
+
+        /** Toggle the whole set (apply if not applied, restore if applied) */
+        inline bool toggle() { return m_applied ? restore() : apply(); }
+
+        /** Dump every patch (@see Patch::dump) */
+        std::string dump() const;
+    };
+} // namespace fatigue
@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <map>
+#include "log.hpp"
+#include "PointerChain.hpp"
+
+namespace fatigue {
+
+    namespace {
+        inline bool sameRegion(const Region& a, const Region& b)
+        {
+            return a.pid == b.pid && a.start == b.start && a.end == b.end;
+        }
+    } // namespace
+
+    PointerChain::PointerChain(const Region& region, const std::string& pattern, int displacement, int instructionLength, const std::vector<int64_t>& offsets, size_t size)
+        : m_pid(region.pid), m_region(region), m_pattern(pattern), m_compiled(search::parsePattern(pattern)),
+          m_displacement(displacement), m_instructionLength(instructionLength), m_offsets(offsets), m_value(size)
+    {
+    }
+
+    PointerChain::PointerChain(pid_t pid, uintptr_t base, const std::vector<int64_t>& offsets, size_t size)
+        : m_pid(pid), m_base(base), m_offsets(offsets), m_value(size)
+    {
+    }
+
+    bool PointerChain::write(const void* buffer, size_t size) const
+    {
+        if (!m_valid || !buffer || size == 0) return false;
+
+        Region space(m_pid, 0, UINTPTR_MAX);
+        space.enforceBounds = false;
+        return space.write(static_cast<ssize_t>(address()), buffer, size) == static_cast<ssize_t>(size);
+    }
+
+    void PointerChain::revalidate(const proc::MapIndex& maps)
+    {
+        if (maps.pid() != m_pid) return;
+
+        // The code holding the instruction was unmapped (or replaced), find the base again
+        if (!m_pattern.empty() && m_base && !maps.contains(m_region.start, m_region.size(), proc::PERM_READ)) {
+            reset();
+            return;
+        }
+
+        size_t level = 0;
+        while (level < m_pointers.size() && maps.contains(addressOf(level), sizeof(uintptr_t), proc::PERM_READ)) level++;
+
+        // Keep the last pointer only if the value it leads to is still mapped
+        if (level == m_offsets.size() && level > 0 && !maps.contains(addressOf(level), m_value.size(), proc::PERM_READ)) level--;
+
+        if (level < m_pointers.size()) {
+            m_pointers.resize(level);
+            m_valid = false;
+        }
+    }
+
+    void PointerChain::reset()
+    {
+        m_pointers.clear();
+        m_valid = false;
+        if (!m_pattern.empty()) m_base = 0;
+    }
+
+    void PointerChain::findBases(std::span<PointerChain* const> chains)
+    {
+        // Group the chains still looking for their base by region, one scan per region
+        std::vector<std::vector<PointerChain*>> groups;
+        for (PointerChain* chain : chains) {
+            if (chain->m_base || chain->m_pattern.empty() || !chain->m_region.isValid()) continue;
+
+            auto group = std::find_if(groups.begin(), groups.end(), [&](const std::vector<PointerChain*>& members) {
+                return sameRegion(members.front()->m_region, chain->m_region);
+            });
+            if (group == groups.end()) {
+                groups.push_back({chain});
+            } else {
+                group->push_back(chain);
+            }
+        }
+
+        for (const std::vector<PointerChain*>& members : groups) {
+            const Region& region = members.front()->m_region;
+
+            std::vector<search::Pattern> patterns;
+            for (PointerChain* chain : members) patterns.push_back(chain->m_compiled);
+            std::vector<std::vector<uintptr_t>> matches = region.findAll(patterns, true);
+
+            // Read every displacement in one batch
+            std::vector<int32_t> displacements(members.size(), 0);
+            std::vector<mem::ReadRequest> requests;
+            std::vector<size_t> found;
+            for (size_t i = 0; i < members.size(); i++) {
+                if (matches.at(i).empty()) {
+                    logWarning(std::format("Pointer chain pattern not found: {}", members.at(i)->m_pattern));
+                    continue;
+                }
+                uintptr_t match = matches.at(i).front();
+                requests.push_back({.address = match + members.at(i)->m_displacement, .buffer = &displacements.at(i), .size = sizeof(int32_t)});
+                found.push_back(i);
+            }
+            region.readMany(requests);
+
+            for (size_t j = 0; j < found.size(); j++) {
+                if (!requests.at(j).complete()) continue;
+
+                size_t i = found.at(j);
+                PointerChain* chain = members.at(i);
+                chain->m_base = region.start + matches.at(i).front() + chain->m_instructionLength + displacements.at(i);
+                chain->m_pointers.clear();
+                logDebug(std::format("Pointer chain base {:#x} from pattern {}", chain->m_base, chain->m_pattern));
+            }
+        }
+    }
+
+    size_t PointerChain::resolveAll(std::span<PointerChain* const> chains, const proc::MapIndex* maps)
+    {
+        if (maps) {
+            for (PointerChain* chain : chains) chain->revalidate(*maps);
+        }
+
+        findBases(chains);
+
+        std::map<pid_t, std::vector<PointerChain*>> processes;
+        for (PointerChain* chain : chains) {
+            chain->m_valid = false;
+            if (chain->m_base) processes[chain->m_pid].push_back(chain);
+        }
+
+        for (const auto& [pid, members] : processes) {
+            // Chains with every level cached: re-read all levels and the value in one batch
+            std::vector<PointerChain*> cached;
+            std::vector<PointerChain*> walking;
+            size_t levels = 0;
+            for (PointerChain* chain : members) {
+                if (chain->m_pointers.size() == chain->m_offsets.size()) {
+                    cached.push_back(chain);
+                    levels += chain->m_offsets.size();
+                } else {
+                    walking.push_back(chain);
+                }
+            }
+
+            std::vector<uintptr_t> pointers(levels, 0);
+            std::vector<mem::ReadRequest> requests;
+            requests.reserve(levels + cached.size());
+            size_t slot = 0;
+            for (PointerChain* chain : cached) {
+                for (size_t level = 0; level < chain->m_offsets.size(); level++) {
+                    requests.push_back({.address = chain->addressOf(level), .buffer = &pointers.at(slot++), .size = sizeof(uintptr_t)});
+                }
+                requests.push_back({.address = chain->addressOf(chain->m_offsets.size()), .buffer = chain->m_value.data(), .size = chain->m_value.size()});
+            }
+            Region::readAbsolute(pid, requests);
+
+            size_t request = 0;
+            slot = 0;
+            for (PointerChain* chain : cached) {
+                size_t depth = chain->m_offsets.size();
+                const mem::ReadRequest* read = &requests.at(request);
+                const uintptr_t* values = pointers.data() + slot;
+                request += depth + 1;
+                slot += depth;
+
+                // Find the first level whose pointer moved (or could not be read)
+                size_t level = 0;
+                while (level < depth && read[level].complete() && values[level] == chain->m_pointers.at(level)) level++;
+
+                if (level == depth) {
+                    chain->m_valid = read[depth].complete();
+                    continue;
+                }
+
+                // Everything above the change still holds, continue walking from the new pointer
+                chain->m_pointers.resize(level);
+                if (read[level].complete() && values[level] != 0) {
+                    chain->m_pointers.push_back(values[level]);
+                    walking.push_back(chain);
+                }
+            }
+
+            // Walk the remaining chains level by level, one batch per level
+            while (!walking.empty()) {
+                std::vector<uintptr_t> next(walking.size(), 0);
+                requests.clear();
+                for (size_t i = 0; i < walking.size(); i++) {
+                    PointerChain* chain = walking.at(i);
+                    size_t level = chain->m_pointers.size();
+                    if (level < chain->m_offsets.size()) {
+                        requests.push_back({.address = chain->addressOf(level), .buffer = &next.at(i), .size = sizeof(uintptr_t)});
+                    } else {
+                        requests.push_back({.address = chain->addressOf(level), .buffer = chain->m_value.data(), .size = chain->m_value.size()});
+                    }
+                }
+                Region::readAbsolute(pid, requests);
+
+                std::vector<PointerChain*> deeper;
+                for (size_t i = 0; i < walking.size(); i++) {
+                    PointerChain* chain = walking.at(i);
+                    size_t level = chain->m_pointers.size();
+
+                    if (!requests.at(i).complete()) {
+                        logDebug(std::format("Pointer chain broken at level {}, {:#x} is not readable", level, requests.at(i).address));
+                        continue;
+                    }
+
+                    if (level == chain->m_offsets.size()) {
+                        chain->m_valid = true;
+                    } else if (next.at(i) == 0) {
+                        logDebug(std::format("Pointer chain broken at level {}, null pointer at {:#x}", level, requests.at(i).address));
+                    } else {
+                        chain->m_pointers.push_back(next.at(i));
+                        deeper.push_back(chain);
+                    }
+                }
+                walking = std::move(deeper);
+            }
+        }
+
+        return std::count_if(chains.begin(), chains.end(), [](const PointerChain* chain) { return chain->m_valid; });
+    }
+} // namespace fatigue
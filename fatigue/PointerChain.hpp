@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <vector>
+#include "MapIndex.hpp"
+#include "Region.hpp"
+#include "utils.hpp"
+
+namespace fatigue {
+    /**
+     * @brief Path from a static pointer through several pointers to a value
+     * The base is either an absolute address, or found from a pattern: the RIP-relative operand of
+     * the matched instruction (e.g. "48 8B 1D ?? ?? ?? ??", mov rbx,[rip+disp32]) gives the address
+     * of the static pointer. Then every offset is one step: read the 64-bit pointer at the current
+     * address and add the offset. The value lives at the last address:
+     *
+     *     value = [[[base] + offsets[0]] + offsets[1]] + ... (no offsets: value at base)
+     *
+     * Resolving is done for many chains at once (@see resolveAll): patterns of the same region are
+     * found in one scan, and every level of every chain is one batched read. The pointers read are
+     * kept between polls; the next poll re-reads all cached levels and the value in a single batch,
+     * and only the chains whose pointers moved are walked again, from the first level that changed.
+     */
+    class PointerChain {
+    protected:
+        pid_t m_pid{0};
+
+        // Base from a pattern
+        Region m_region{};
+        std::string m_pattern{};
+        search::Pattern m_compiled{};
+        /** Position of the rel32 displacement from the match */
+        int m_displacement{0};
+        /** Length of the matched instruction, the displacement is relative to its end */
+        int m_instructionLength{0};
+
+        /** Absolute address of the static pointer (or of the value, without offsets), 0 until found */
+        uintptr_t m_base{0};
+        std::vector<int64_t> m_offsets{};
+
+        /** Pointers read at each level so far, the cached prefix of the path */
+        std::vector<uintptr_t> m_pointers{};
+        /** Value as of the last resolve */
+        std::vector<uint8_t> m_value{};
+        bool m_valid{false};
+
+        /** Absolute address read at a level (level offsets.size() is the value) */
+        inline uintptr_t addressOf(size_t level) const
+        {
+            return level == 0 ? m_base : m_pointers.at(level - 1) + m_offsets.at(level - 1);
+        }
+
+        static void findBases(std::span<PointerChain* const> chains);
+
+    public:
+        PointerChain() = default;
+        /**
+         * @brief Chain whose base is the target of a RIP-relative instruction found by pattern
+         * @param region Region to search (usually .text)
+         * @param pattern Pattern of the instruction (@see fatigue::search::parsePattern)
+         * @param displacement Position of the rel32 displacement from the match (3 for 48 8B 1D)
+         * @param instructionLength Length of the instruction (7 for 48 8B 1D)
+         * @param offsets Offset added after each dereference
+         * @param size Size of the value in bytes
+         */
+        PointerChain(const Region& region, const std::string& pattern, int displacement, int instructionLength, const std::vector<int64_t>& offsets, size_t size);
+        /**
+         * @brief Chain from a known static address
+         * @param base Absolute address of the static pointer
+         */
+        PointerChain(pid_t pid, uintptr_t base, const std::vector<int64_t>& offsets, size_t size);
+        ~PointerChain() = default;
+
+        inline pid_t pid() const { return m_pid; }
+        inline uintptr_t base() const { return m_base; }
+        inline const std::vector<int64_t>& offsets() const { return m_offsets; }
+        /** Number of dereferences */
+        inline size_t depth() const { return m_offsets.size(); }
+        /** Check if the last resolve reached the value */
+        inline bool isValid() const { return m_valid; }
+        /** Number of levels whose pointer is cached */
+        inline size_t cachedLevels() const { return m_pointers.size(); }
+
+        /** Absolute address of the value, 0 if not resolved */
+        inline uintptr_t address() const { return m_valid ? addressOf(m_offsets.size()) : 0; }
+        /** Raw value as of the last resolve */
+        inline const std::vector<uint8_t>& data() const { return m_value; }
+
+        /**
+         * Get the value as of the last resolve
+         * @return false if not resolved, or the value is smaller than T
+         */
+        template <typename T>
+        bool get(T& value) const
+        {
+            if (!m_valid || m_value.size() < sizeof(T)) return false;
+            memcpy(&value, m_value.data(), sizeof(T));
+            return true;
+        }
+
+        /** Write the value at the resolved address (resolve first) */
+        bool write(const void* buffer, size_t size) const;
+        template <typename T>
+        bool write(const T& value) const { return write(&value, sizeof(T)); }
+
+        /**
+         * @brief Drop cached levels that are no longer mapped readable
+         * Call when the maps changed (e.g. from a proc::MapWatcher listener); a base found by pattern
+         * is dropped too if its region is gone, so it is found again.
+         */
+        void revalidate(const proc::MapIndex& maps);
+        /** Forget everything cached, including the base found by pattern */
+        void reset();
+
+        /** Resolve this chain alone (@see resolveAll) */
+        inline bool resolve()
+        {
+            PointerChain* self = this;
+            return resolveAll({&self, 1}) == 1;
+        }
+
+        /**
+         * @brief Resolve many independent chains together
+         * Bases are found first (one MultiPattern scan per region, one batched read of the
+         * displacements). Chains with every level cached are verified with one batch holding every
+         * level and the value of every chain. Chains that are not cached, or whose pointers changed,
+         * are then walked level by level, each level of all of them in one batched read.
+         * @param maps If given, cached levels are first revalidated against it (@see revalidate)
+         * @return Number of chains that reached their value
+         */
+        static size_t resolveAll(std::span<PointerChain* const> chains, const proc::MapIndex* maps = nullptr);
+    };
+} // namespace fatigue
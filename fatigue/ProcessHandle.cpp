@@ -0,0 +1,131 @@
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <format>
+#include <mutex>
+#include <poll.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <unordered_map>
+#include "log.hpp"
+#include "ProcessHandle.hpp"
+#include "ProcessScanner.hpp"
+
+namespace fatigue::mem {
+
+    namespace {
+        std::mutex s_handlesMutex;
+        std::unordered_map<pid_t, std::shared_ptr<ProcessHandle>> s_handles;
+    } // namespace
+
+    ProcessHandle::ProcessHandle(pid_t pid) : m_pid(pid)
+    {
+        if (pid <= 0) return;
+
+        // Take the pidfd first, so it refers to the same process the mem file is opened for
+#ifdef SYS_pidfd_open
+        m_pidfd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#endif
+
+        char path[32];
+        snprintf(path, sizeof(path), "/proc/%d/mem", pid);
+
+        m_mem = open(path, O_RDWR | O_CLOEXEC);
+        m_writable = m_mem >= 0;
+        if (m_mem < 0) m_mem = open(path, O_RDONLY | O_CLOEXEC);
+
+        if (m_mem < 0) {
+            logDebug(std::format("Failed to open /proc/{}/mem: {}", pid, strerror(errno)));
+            return;
+        }
+
+        // Read after the open: if it is still the start time of an earlier handle, so was the mem file
+        m_startTime = proc::getProcessInfo(pid).startTime;
+    }
+
+    ProcessHandle::~ProcessHandle()
+    {
+        if (m_mem >= 0) close(m_mem);
+        if (m_pidfd >= 0) close(m_pidfd);
+    }
+
+    bool ProcessHandle::isAlive() const
+    {
+        if (m_pidfd >= 0) {
+            // A pidfd becomes readable once the process exits
+            struct pollfd fd = { .fd = m_pidfd, .events = POLLIN, .revents = 0 };
+            return poll(&fd, 1, 0) == 0;
+        }
+
+        // Without pidfd support, this cannot tell a reused pid apart, but the mem file can't either way
+        return kill(m_pid, 0) == 0 || errno == EPERM;
+    }
+
+    ssize_t ProcessHandle::read(uintptr_t address, void* buffer, size_t size) const
+    {
+        return pread64(m_mem, buffer, size, address);
+    }
+
+    ssize_t ProcessHandle::write(uintptr_t address, const void* buffer, size_t size) const
+    {
+        if (!m_writable) {
+            errno = EBADF;
+            return -1;
+        }
+        return pwrite64(m_mem, buffer, size, address);
+    }
+
+    std::shared_ptr<ProcessHandle> ProcessHandle::get(pid_t pid)
+    {
+        if (pid <= 0) return nullptr;
+
+        std::lock_guard lock(s_handlesMutex);
+
+        auto it = s_handles.find(pid);
+        if (it != s_handles.end()) return it->second;
+
+        auto handle = std::make_shared<ProcessHandle>(pid);
+        if (!handle->isOpen()) {
+            s_handles.erase(pid);
+            return nullptr;
+        }
+
+        s_handles[pid] = handle;
+        return handle;
+    }
+
+    std::shared_ptr<ProcessHandle> ProcessHandle::reopen(const std::shared_ptr<ProcessHandle>& stale)
+    {
+        if (!stale) return nullptr;
+
+        auto handle = std::make_shared<ProcessHandle>(stale->pid());
+
+        // Checked after the open, as the pid cannot be reused while the stale process is alive
+        if (!handle->isOpen() || !stale->isAlive() || handle->startTime() != stale->startTime()) {
+            logDebug(std::format("Not reopening /proc/{}/mem: the process has exited", stale->pid()));
+            return nullptr;
+        }
+
+        // Only replace the cached handle if nobody has replaced it already
+        std::lock_guard lock(s_handlesMutex);
+        auto it = s_handles.find(stale->pid());
+        if (it == s_handles.end() || it->second == stale) {
+            s_handles[stale->pid()] = handle;
+            return handle;
+        }
+        return it->second;
+    }
+
+    void ProcessHandle::release(pid_t pid)
+    {
+        std::lock_guard lock(s_handlesMutex);
+        s_handles.erase(pid);
+    }
+
+    void ProcessHandle::releaseAll()
+    {
+        std::lock_guard lock(s_handlesMutex);
+        s_handles.clear();
+    }
+} // namespace fatigue::mem
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <sys/types.h>
+
+namespace fatigue::mem {
+    /**
+     * @brief Open /proc/[pid]/mem file descriptor for a process
+     * Keeps the mem file open between reads and writes, instead of opening and closing it on
+     * every access. Handles are cached per pid (see get()), so every Region and io:: call for
+     * the same process shares one descriptor.
+     *
+     * A mem descriptor stays bound to the address space it was opened for, so if the process
+     * exits (and the pid is reused) it can never read or write the new process; accesses just
+     * fail, and keep failing: a dead handle is never replaced behind the caller's back. A pidfd
+     * and the start time of the process are held alongside it to tell when that happened.
+     */
+    class ProcessHandle {
+    protected:
+        pid_t m_pid{0};
+        int m_mem{-1};
+        int m_pidfd{-1};
+        /** Start time of the process (@see proc::ProcessInfo), read after opening the mem file */
+        unsigned long long m_startTime{0};
+        bool m_writable{false};
+
+    public:
+        /** Open /proc/[pid]/mem (read-write if permitted, otherwise read only) and a pidfd */
+        explicit ProcessHandle(pid_t pid);
+        ~ProcessHandle();
+
+        ProcessHandle(const ProcessHandle&) = delete;
+        ProcessHandle& operator=(const ProcessHandle&) = delete;
+
+        inline pid_t pid() const { return m_pid; }
+        inline int fd() const { return m_mem; }
+        inline bool isOpen() const { return m_mem >= 0; }
+        inline bool isWritable() const { return m_writable; }
+        inline unsigned long long startTime() const { return m_startTime; }
+
+        /** Check if the process this handle was opened for is still running */
+        bool isAlive() const;
+
+        /** Read process memory at an absolute address with pread */
+        ssize_t read(uintptr_t address, void* buffer, size_t size) const;
+        /** Write process memory at an absolute address with pwrite */
+        ssize_t write(uintptr_t address, const void* buffer, size_t size) const;
+
+        /**
+         * Get the shared handle for a process, opening it if needed
+         * @return Handle, or nullptr if /proc/[pid]/mem could not be opened
+         */
+        static std::shared_ptr<ProcessHandle> get(pid_t pid);
+        /**
+         * @brief Open a fresh handle for the same process, e.g. after it called execve
+         * The mem file of a process that replaced its address space reads nothing, a new one is
+         * needed. Never called implicitly: the fresh handle is only returned (and cached) if the
+         * process of the stale one is still alive and the pid still has its start time, so a
+         * reused pid is never picked up.
+         * @return Fresh handle, or nullptr if the process has exited or could not be opened
+         */
+        static std::shared_ptr<ProcessHandle> reopen(const std::shared_ptr<ProcessHandle>& stale);
+        /** Drop the cached handle for a process (it closes once nothing else uses it) */
+        static void release(pid_t pid);
+        /** Drop all cached handles */
+        static void releaseAll();
+    };
+} // namespace fatigue::mem
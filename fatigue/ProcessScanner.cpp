@@ -0,0 +1,257 @@
+#include <charconv>
+#include <cstring>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <format>
+#include <memory>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "log.hpp"
+#include "ProcessScanner.hpp"
+
+namespace fatigue::proc {
+
+    namespace {
+        /** Layout of the records returned by getdents64 (not exported by glibc headers) */
+        struct LinuxDirent64 {
+            uint64_t d_ino;
+            int64_t d_off;
+            unsigned short d_reclen;
+            unsigned char d_type;
+            char d_name[];
+        };
+
+        const size_t s_entriesBufferSize = 32 * 1024;
+        /** A rejected pid is checked again once every this many scans (spread out over the pids) */
+        const uint64_t s_recheckScans = 16;
+
+        /** Read a small /proc file relative to a pid into a buffer, returns bytes read or -1 */
+        ssize_t readProcFile(pid_t pid, const char* file, char* buffer, size_t size)
+        {
+            char path[64];
+            snprintf(path, sizeof(path), "/proc/%d/%s", pid, file);
+
+            int fd = open(path, O_RDONLY | O_CLOEXEC);
+            if (fd < 0) return -1;
+
+            size_t total = 0;
+            while (total < size) {
+                ssize_t bytesRead = ::read(fd, buffer + total, size - total);
+                if (bytesRead < 0 && errno == EINTR) continue;
+                if (bytesRead <= 0) break;
+                total += bytesRead;
+            }
+
+            close(fd);
+            return total;
+        }
+
+        /** Trim trailing NULs and whitespace, like string::trim does at the end of getCmdline() */
+        std::string_view trimEnd(std::string_view text)
+        {
+            while (!text.empty() && (static_cast<unsigned char>(text.back()) <= ' ')) text.remove_suffix(1);
+            return text;
+        }
+    } // namespace
+
+    size_t readComm(pid_t pid, char* buffer, size_t size)
+    {
+        if (pid <= 0 || !buffer || size == 0) return 0;
+
+        ssize_t bytesRead = readProcFile(pid, "comm", buffer, size);
+        if (bytesRead <= 0) return 0;
+
+        size_t length = bytesRead;
+        if (buffer[length - 1] == '\n') length--;
+        return length;
+    }
+
+    bool readCmdline(pid_t pid, std::string& buffer)
+    {
+        buffer.clear();
+        if (pid <= 0) return false;
+
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/%d/cmdline", pid);
+
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+
+        // Grow into the existing capacity first, only allocate for unusually long command lines
+        buffer.resize(std::max<size_t>(buffer.capacity(), 4096));
+        size_t total = 0;
+        while (true) {
+            if (total == buffer.size()) buffer.resize(buffer.size() * 2);
+
+            ssize_t bytesRead = ::read(fd, buffer.data() + total, buffer.size() - total);
+            if (bytesRead < 0 && errno == EINTR) continue;
+            if (bytesRead <= 0) break;
+            total += bytesRead;
+        }
+        close(fd);
+
+        buffer.resize(trimEnd({buffer.data(), total}).size());
+        return true;
+    }
+
+    // ProcessScanner
+
+    ProcessScanner::ProcessScanner(Filter filter, std::chrono::milliseconds settle)
+        : m_filter(std::move(filter)), m_settle(settle)
+    {
+        m_proc = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (m_proc < 0) {
+            logError(std::format("Error opening /proc: {}", strerror(errno)));
+        }
+        m_entries.resize(s_entriesBufferSize);
+    }
+
+    ProcessScanner::~ProcessScanner()
+    {
+        if (m_proc >= 0) close(m_proc);
+    }
+
+    pid_t ProcessScanner::scan()
+    {
+        std::vector<pid_t> found = list(false);
+        return found.empty() ? 0 : found.front();
+    }
+
+    std::vector<pid_t> ProcessScanner::scanAll()
+    {
+        return list(true);
+    }
+
+    std::vector<pid_t> ProcessScanner::list(bool all)
+    {
+        std::vector<pid_t> found;
+        if (m_proc < 0 || !m_filter) return found;
+
+        // Rewind, so the directory is listed again from the start
+        if (lseek(m_proc, 0, SEEK_SET) < 0) return found;
+
+        m_scan++;
+        auto now = std::chrono::steady_clock::now();
+        bool complete = true;
+
+        while (true) {
+            long bytes = syscall(SYS_getdents64, m_proc, m_entries.data(), m_entries.size());
+            if (bytes < 0) {
+                complete = false;
+                break;
+            }
+            if (bytes == 0) break;
+
+            for (long position = 0; position < bytes;) {
+                auto* entry = reinterpret_cast<const LinuxDirent64*>(m_entries.data() + position);
+                position += entry->d_reclen;
+
+                if (entry->d_type != DT_DIR && entry->d_type != DT_UNKNOWN) continue;
+
+                pid_t pid = 0;
+                const char* name = entry->d_name;
+                const char* nameEnd = name + strlen(name);
+                auto [end, error] = std::from_chars(name, nameEnd, pid);
+                if (error != std::errc{} || end != nameEnd || pid <= 0) continue;
+
+                auto [it, inserted] = m_seen.try_emplace(pid, Seen{now, m_scan, false});
+                Seen& seen = it->second;
+                seen.scan = m_scan;
+
+                // Keep listing after a match, so exited pids can still be told apart below
+                if (!all && !found.empty()) continue;
+                // A process may rename itself long after it started (e.g. a slow Wine prefix start-up)
+                if (seen.rejected && (m_scan + static_cast<uint64_t>(pid)) % s_recheckScans != 0) continue;
+
+                if (m_filter(pid)) {
+                    found.push_back(pid);
+                } else if (now - seen.firstSeen >= m_settle) {
+                    seen.rejected = true;
+                }
+            }
+        }
+
+        // Forget pids that are gone, their numbers may come back as new processes
+        if (complete) {
+            std::erase_if(m_seen, [this](const auto& item) { return item.second.scan != m_scan; });
+        }
+
+        return found;
+    }
+
+    // Process info
+
+    ProcessInfo getProcessInfo(pid_t pid)
+    {
+        ProcessInfo info{};
+        if (pid <= 0) return info;
+
+        char stat[1024];
+        ssize_t length = readProcFile(pid, "stat", stat, sizeof(stat));
+        if (length <= 0) return info;
+
+        // (format) pid (comm) state ppid ... starttime (22nd field); comm may contain spaces and parens
+        std::string_view text(stat, length);
+        size_t open = text.find('(');
+        size_t close = text.rfind(')');
+        if (open == std::string_view::npos || close == std::string_view::npos || close < open) return info;
+
+        info.pid = pid;
+        info.comm = std::string(text.substr(open + 1, close - open - 1));
+
+        std::string_view fields = text.substr(close + 1);
+        for (int field = 3; field <= 22 && !fields.empty(); field++) {
+            while (!fields.empty() && fields.front() == ' ') fields.remove_prefix(1);
+            size_t space = fields.find(' ');
+            std::string_view value = fields.substr(0, space);
+            fields.remove_prefix(space == std::string_view::npos ? fields.size() : space);
+
+            if (field == 4) std::from_chars(value.data(), value.data() + value.size(), info.ppid);
+            if (field == 22) std::from_chars(value.data(), value.data() + value.size(), info.startTime);
+        }
+
+        char path[64];
+        char exe[4096];
+        snprintf(path, sizeof(path), "/proc/%d/exe", pid);
+        ssize_t exeLength = readlink(path, exe, sizeof(exe));
+        if (exeLength > 0) info.exe = std::string(exe, exeLength);
+
+        return info;
+    }
+
+    // Filters
+
+    ProcessScanner::Filter matchStatusName(const std::string& name)
+    {
+        return [name](pid_t pid) {
+            char comm[64];
+            size_t length = readComm(pid, comm, sizeof(comm));
+            return length > 0 && std::string_view(comm, length) == name;
+        };
+    }
+
+    ProcessScanner::Filter matchCmdline(const std::string& cmdline)
+    {
+        auto buffer = std::make_shared<std::string>();
+        return [cmdline, buffer](pid_t pid) {
+            return readCmdline(pid, *buffer) && *buffer == cmdline;
+        };
+    }
+
+    ProcessScanner::Filter matchCmdlineEndsWith(const std::string& cmdline)
+    {
+        auto buffer = std::make_shared<std::string>();
+        return [cmdline, buffer](pid_t pid) {
+            return readCmdline(pid, *buffer) && buffer->ends_with(cmdline);
+        };
+    }
+
+    ProcessScanner::Filter matchCmdlineContains(const std::string& cmdline)
+    {
+        auto buffer = std::make_shared<std::string>();
+        return [cmdline, buffer](pid_t pid) {
+            return readCmdline(pid, *buffer) && buffer->contains(cmdline);
+        };
+    }
+} // namespace fatigue::proc
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+namespace fatigue::proc {
+    /**
+     * Read /proc/[pid]/comm (the same name as Name in /proc/[pid]/status) into a buffer
+     * @return Length of the name without the trailing newline, 0 if it could not be read
+     */
+    size_t readComm(pid_t pid, char* buffer, size_t size);
+
+    /**
+     * Read /proc/[pid]/cmdline into a reusable string (its capacity is kept between calls)
+     * Arguments stay NUL separated, trailing NULs and spaces are trimmed like getCmdline()
+     * @return false if it could not be read
+     */
+    bool readCmdline(pid_t pid, std::string& buffer);
+
+    /** Cheap facts about a process, from /proc/[pid]/stat and /proc/[pid]/exe */
+    struct ProcessInfo {
+        pid_t pid{0};
+        pid_t ppid{0};
+        /** Start time in clock ticks since boot, larger is newer */
+        unsigned long long startTime{0};
+        /** Process name (same as Name in /proc/[pid]/status) */
+        std::string comm;
+        /** Target of /proc/[pid]/exe, empty if not permitted (e.g. wine-preloader under Proton) */
+        std::string exe;
+    };
+
+    /**
+     * Read the info of a process
+     * @return Info with pid 0 if the process does not exist
+     */
+    ProcessInfo getProcessInfo(pid_t pid);
+
+    /**
+     * @brief Repeated scans of /proc for a process matching a filter
+     * The /proc directory is kept open and listed with getdents64 into a reused buffer, so a scan
+     * makes no allocations for pids it has seen before. Pids rejected by the filter are remembered
+     * and mostly skipped by later scans, once they are older than the settle time (a young process
+     * may still exec or rename itself, so it is checked again until then). A process can still do
+     * so later, so each rejected pid is checked again every 16th scan, which keeps the cost of a
+     * scan low without missing it for good. Pids that disappear from /proc are forgotten, so a
+     * reused pid is checked again.
+     */
+    class ProcessScanner {
+    public:
+        using Filter = std::function<bool(pid_t)>;
+
+    protected:
+        struct Seen {
+            /** When this scanner first listed the pid */
+            std::chrono::steady_clock::time_point firstSeen;
+            /** Last scan that listed the pid, used to forget exited processes */
+            uint64_t scan{0};
+            bool rejected{false};
+        };
+
+        Filter m_filter;
+        std::chrono::milliseconds m_settle;
+        int m_proc{-1};
+        std::vector<char> m_entries{};
+        std::unordered_map<pid_t, Seen> m_seen{};
+        uint64_t m_scan{0};
+
+        /** List /proc, stopping at the first match unless all is set */
+        std::vector<pid_t> list(bool all);
+
+    public:
+        /**
+         * @param filter Called for each candidate pid, return true for the wanted process
+         * @param settle How long a pid is checked again before a rejection is final
+         */
+        explicit ProcessScanner(Filter filter, std::chrono::milliseconds settle = std::chrono::milliseconds(1000));
+        ~ProcessScanner();
+
+        ProcessScanner(const ProcessScanner&) = delete;
+        ProcessScanner& operator=(const ProcessScanner&) = delete;
+
+        /** List /proc once and return the first pid accepted by the filter, or 0 */
+        pid_t scan();
+        /** List /proc once and return every pid accepted by the filter, in /proc order */
+        std::vector<pid_t> scanAll();
+
+        /** Check a single pid against the filter (e.g. one reported by ExecMonitor) */
+        inline bool matches(pid_t pid) const { return pid > 0 && m_filter && m_filter(pid); }
+
+        /** Forget all rejected pids, so the next scan checks everything again */
+        inline void reset() { m_seen.clear(); }
+    };
+
+    /** Filter matching /proc/[pid]/comm exactly (@see getProcessIdByStatusName) */
+    ProcessScanner::Filter matchStatusName(const std::string& name);
+    /** Filter matching the whole /proc/[pid]/cmdline (@see getProcessId) */
+    ProcessScanner::Filter matchCmdline(const std::string& cmdline);
+    /** Filter matching the end of /proc/[pid]/cmdline (@see getProcessIdByCmdlineEndsWith) */
+    ProcessScanner::Filter matchCmdlineEndsWith(const std::string& cmdline);
+    /** Filter matching anywhere in /proc/[pid]/cmdline (@see getProcessIdByCmdlineContains) */
+    ProcessScanner::Filter matchCmdlineContains(const std::string& cmdline);
+} // namespace fatigue::proc
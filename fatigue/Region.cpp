@@ -1,29 +1,40 @@
 #include "Region.hpp"
+#include "scan.hpp"
 
 using namespace fatigue::mem;
 
 namespace fatigue {
+    ssize_t Region::readProcess(uintptr_t address, void* buffer, size_t size) const
+    {
+        if (method == AccessMethod::SYS) {
+            return sys::read(pid, address, buffer, size);
+        } else if (method == AccessMethod::IO) {
+            return io::read(pid, address, buffer, size);
+        } else if (method == AccessMethod::PTRACE) {
+            return trace::read(pid, address, buffer, size);
+        } else if (method == AccessMethod::URING) {
+            return uring::read(pid, address, buffer, size);
+        }
+        throw std::runtime_error("Invalid memory access method");
+    }
+
     ssize_t Region::read(ssize_t offset, void* buffer, size_t size) const
     {
+        if (sparse) return readSparse(offset, buffer, size);
         if (!isValid() || !buffer || size == 0) return -1;
         if (enforceBounds) {
             if (offset < 0) throw std::out_of_range("Attempted read before start of region");
             if (start + offset + size > end) throw std::out_of_range("Attempted read past end of region");
         }
 
-        ssize_t bytesRead = 0;
-        errno = 0;
-
-        if (method == AccessMethod::SYS) {
-            bytesRead = sys::read(pid, start + offset, buffer, size);
-        } else if (method == AccessMethod::IO) {
-            bytesRead = io::read(pid, start + offset, buffer, size);
-        } else if (method == AccessMethod::PTRACE) {
-            bytesRead = trace::read(pid, start + offset, buffer, size);
-        } else {
-            throw std::runtime_error("Invalid memory access method");
+        // Serve from the snapshot if it holds the whole range
+        if (m_snapshot && m_snapshot->read(start + offset, buffer, size)) {
+            return size;
         }
 
+        errno = 0;
+        ssize_t bytesRead = readProcess(start + offset, buffer, size);
+
         if (bytesRead < 0) {
             logError(std::format("Failed to read {} bytes from {:#x}-{:#x}: {}", size, start + offset, start + offset + size, strerror(errno)));
             throw std::runtime_error(std::format("Read error: {}", strerror(errno)));
@@ -32,6 +43,113 @@ namespace fatigue {
         return bytesRead;
     }
 
+    ssize_t Region::readSparse(ssize_t offset, void* buffer, size_t size, mem::PageBitmap* holes) const
+    {
+        if (!isValid() || !buffer || size == 0) return -1;
+        if (enforceBounds) {
+            if (offset < 0) throw std::out_of_range("Attempted read before start of region");
+            if (start + offset + size > end) throw std::out_of_range("Attempted read past end of region");
+        }
+
+        mem::PageBitmap local;
+        mem::PageBitmap& bitmap = holes ? *holes : local;
+        bitmap = mem::PageBitmap(start + offset, size);
+
+        if (m_snapshot && m_snapshot->read(start + offset, buffer, size)) {
+            return size;
+        }
+
+        // Read as much as possible in one go; a short read stops at the first page that cannot be
+        // read, so zero that page, flag it, and carry on from the next one
+        uint8_t* bytes = static_cast<uint8_t*>(buffer);
+        size_t done = 0;
+        while (done < size) {
+            errno = 0;
+            ssize_t bytesRead = readProcess(start + offset + done, bytes + done, size - done);
+            if (bytesRead > 0) {
+                done += bytesRead;
+                continue;
+            }
+
+            uintptr_t address = start + offset + done;
+            size_t skip = std::min(mem::pageSize() - address % mem::pageSize(), size - done);
+            memset(bytes + done, 0, skip);
+            bitmap.mark(done, skip);
+            done += skip;
+        }
+
+        size_t unreadable = bitmap.unreadableBytes();
+        if (unreadable > 0) {
+            logDebug(std::format("Skipped {} unreadable bytes in {:#x}-{:#x}", unreadable, start + offset, start + offset + size));
+        }
+
+        return size - unreadable;
+    }
+
+    size_t Region::readMany(std::span<mem::ReadRequest> requests) const
+    {
+        if (!isValid()) return 0;
+
+        // Convert to absolute addresses, skipping anything the snapshot can answer
+        std::vector<mem::ReadRequest> remote;
+        std::vector<size_t> index;
+        remote.reserve(requests.size());
+        index.reserve(requests.size());
+
+        size_t complete = 0;
+        for (size_t i = 0; i < requests.size(); i++) {
+            auto& request = requests[i];
+            request.bytesRead = 0;
+            request.error = 0;
+
+            if (enforceBounds && (static_cast<intptr_t>(request.address) < 0 || start + request.address + request.size > end)) {
+                request.error = EFAULT;
+                continue;
+            }
+
+            if (m_snapshot && m_snapshot->read(start + request.address, request.buffer, request.size)) {
+                request.bytesRead = request.size;
+                complete++;
+                continue;
+            }
+
+            remote.push_back({.address = start + request.address, .buffer = request.buffer, .size = request.size});
+            index.push_back(i);
+        }
+
+        if (remote.empty()) return complete;
+
+        if (method == AccessMethod::PTRACE) {
+            for (auto& request : remote) {
+                errno = 0;
+                request.bytesRead = trace::read(pid, request.address, request.buffer, request.size);
+                if (!request.complete()) request.error = errno;
+            }
+        } else if (method == AccessMethod::URING) {
+            uring::readv(pid, remote);
+        } else {
+            sys::readv(pid, remote);
+        }
+
+        for (size_t i = 0; i < remote.size(); i++) {
+            auto& request = requests[index.at(i)];
+            request.bytesRead = remote.at(i).bytesRead;
+            request.error = remote.at(i).error;
+            if (request.complete()) complete++;
+        }
+
+        return complete;
+    }
+
+    size_t Region::readAbsolute(pid_t pid, std::span<mem::ReadRequest> requests)
+    {
+        if (requests.empty()) return 0;
+
+        Region space(pid, 0, UINTPTR_MAX);
+        space.enforceBounds = false;
+        return space.readMany(requests);
+    }
+
     ssize_t Region::write(ssize_t offset, const void* buffer, size_t size) const
     {
         if (!isValid() || !buffer || size == 0) return -1;
@@ -49,6 +167,8 @@ namespace fatigue {
             bytesWritten = io::write(pid, start + offset, buffer, size);
         } else if (method == AccessMethod::PTRACE) {
             bytesWritten = trace::write(pid, start + offset, buffer, size);
+        } else if (method == AccessMethod::URING) {
+            bytesWritten = uring::write(pid, start + offset, buffer, size);
         } else {
             throw std::runtime_error("Invalid memory access method");
         }
@@ -58,33 +178,137 @@ namespace fatigue {
             throw std::runtime_error(std::format("Write error: {}", strerror(errno)));
         }
 
+        // Keep the snapshot consistent with what was written
+        if (m_snapshot) {
+            m_snapshot->update(start + offset, buffer, bytesWritten);
+            if (static_cast<size_t>(bytesWritten) != size) m_snapshot->invalidate();
+        }
+
         return bytesWritten;
     }
 
+    std::shared_ptr<RegionSnapshot> Region::takeSnapshot()
+    {
+        m_snapshot = std::make_shared<RegionSnapshot>();
+        m_snapshot->refresh(*this);
+        return m_snapshot;
+    }
+
+    bool Region::refresh() const
+    {
+        return m_snapshot && m_snapshot->refresh(*this);
+    }
+
+    void Region::scan(size_t overlap, const std::function<bool(size_t, std::span<const uint8_t>)>& fn) const
+    {
+        if (!isValid() || !fn) return;
+
+        // A fresh snapshot already holds the whole region, scan it in place
+        if (m_snapshot) {
+            if (!m_snapshot->covers(start, size())) refresh();
+            if (m_snapshot->covers(start, size())) {
+                fn(0, {m_snapshot->data() + (start - m_snapshot->start()), size()});
+                return;
+            }
+        }
+
+        // Without a chunk size, read the whole region at once
+        size_t chunk = chunkSize > 0 ? std::min(chunkSize, size()) : size();
+
+        // Reusable buffer: the tail of the previous chunk is carried to the front, then the next chunk is read after it
+        std::vector<uint8_t> buffer(std::min(chunk + overlap, size()));
+        size_t carried = 0;
+
+        mem::PageBitmap holes;
+        for (size_t next = 0; next < size();) {
+            size_t length = std::min(buffer.size() - carried, size() - next);
+            readSparse(next, buffer.data() + carried, length, &holes);
+
+            // Hand over each readable stretch (the carried bytes join the first one if it starts the chunk)
+            size_t filled = carried + length;
+            size_t spanStart = 0;
+            size_t spanEnd = 0;
+            for (auto& [runOffset, runLength] : holes.readable()) {
+                spanStart = runOffset == 0 ? 0 : carried + runOffset;
+                spanEnd = carried + runOffset + runLength;
+                if (!fn(next - carried + spanStart, {buffer.data() + spanStart, spanEnd - spanStart})) return;
+            }
+
+            next += length;
+            // Only carry bytes over if the chunk ends readable, a pattern cannot span a hole
+            carried = spanEnd == filled ? std::min(overlap, spanEnd - spanStart) : 0;
+            memmove(buffer.data(), buffer.data() + filled - carried, carried);
+        }
+    }
+
     std::vector<uintptr_t> Region::find(const void* pattern, size_t patternSize, const std::string& mask, bool first) const
     {
         if (!isValid() || !pattern || patternSize == 0) return {};
 
-        // Copy the memory region into a buffer
-        // TODO: Save this in the object for multiple searches, allow refresh
-        std::vector<uint8_t> buffer;
-        buffer.reserve(size());
-        read(0, buffer.data(), size());
+        // Hand big regions to the worker pool when parallel scans are enabled (a snapshot is already local,
+        // and a chunk size of 0 asks for the whole region in one read)
+        if (scan::getThreadCount() != 1 && !hasSnapshot() && chunkSize > 0 && size() > chunkSize) {
+            const uint8_t* bytes = static_cast<const uint8_t*>(pattern);
+            search::Pattern parsed{{bytes, bytes + patternSize}, mask};
+            return scan::find(*this, parsed, first);
+        }
+
+        std::vector<uintptr_t> found{};
+        // End of the previous chunk, matches that fit before it were already reported
+        size_t previousEnd = 0;
+
+        scan(patternSize - 1, [&](size_t offset, std::span<const uint8_t> data) {
+            for (auto match : search::search(data.data(), data.size(), pattern, patternSize, mask, first)) {
+                if (offset + match + patternSize <= previousEnd) continue;
+                found.push_back(offset + match);
+                if (first) return false;
+            }
+            previousEnd = offset + data.size();
+            return true;
+        });
 
-        // Search the buffer for the pattern
-        return search::search(buffer.data(), size(), pattern, patternSize, mask, first);
+        return found;
     }
 
     std::vector<uintptr_t> Region::find(std::string_view pattern, bool first) const
     {
         if (!isValid() || pattern.empty()) return {};
 
-        // Copy the memory region into a buffer
-        std::vector<uint8_t> buffer;
-        buffer.reserve(size());
-        read(0, buffer.data(), size());
+        search::Pattern parsed = search::parsePattern(pattern);
+        return find(parsed.bytes.data(), parsed.bytes.size(), parsed.mask, first);
+    }
+
+    std::vector<std::vector<uintptr_t>> Region::findAll(const search::MultiPattern& patterns, bool first) const
+    {
+        std::vector<std::vector<uintptr_t>> found(patterns.size());
+        const size_t longest = patterns.maxPatternSize();
+        if (!isValid() || longest == 0) return found;
+
+        // Empty patterns never match, so they must not hold up stopping at the first matches
+        size_t previousEnd = 0;
+        size_t remaining = 0;
+        for (size_t i = 0; i < patterns.size(); i++) {
+            if (!patterns.pattern(i).bytes.empty()) remaining++;
+        }
+
+        // Overlap chunks by the longest pattern, so no pattern can straddle a chunk boundary unseen
+        scan(longest - 1, [&](size_t offset, std::span<const uint8_t> data) {
+            auto chunkFound = patterns.search(data.data(), data.size(), first);
+
+            for (size_t i = 0; i < chunkFound.size(); i++) {
+                size_t patternSize = patterns.pattern(i).bytes.size();
+                for (auto match : chunkFound.at(i)) {
+                    if (offset + match + patternSize <= previousEnd) continue;
+                    if (first && !found.at(i).empty()) break;
+                    found.at(i).push_back(offset + match);
+                    if (first) remaining--;
+                }
+            }
+
+            previousEnd = offset + data.size();
+            return !(first && remaining == 0);
+        });
 
-        // Search the buffer for the pattern
-        return search::search(buffer.data(), size(), pattern, first);
+        return found;
     }
 } // namespace fatigue
@@ -3,16 +3,24 @@
 #include <cstring>
 #include <errno.h>
 #include <format>
+#include <functional>
+#include <memory>
+#include <span>
 #include <stdexcept>
 #include <vector>
 #include "log.hpp"
 #include "mem.hpp"
+#include "RegionSnapshot.hpp"
 #include "utils.hpp"
 
 #ifndef DEFAULT_MEMORY_ACCESS_METHOD
 #define DEFAULT_MEMORY_ACCESS_METHOD fatigue::mem::AccessMethod::SYS
 #endif
 
+#ifndef DEFAULT_SCAN_CHUNK_SIZE
+#define DEFAULT_SCAN_CHUNK_SIZE (2 * 1024 * 1024)
+#endif
+
 using namespace fatigue::mem;
 
 namespace fatigue {
@@ -24,6 +32,13 @@ namespace fatigue {
      * methods available in the mem namespace.
      */
     class Region {
+    protected:
+        /** Optional local copy of the region, shared between copies of this region */
+        std::shared_ptr<RegionSnapshot> m_snapshot{nullptr};
+
+        /** Read from process memory at an absolute address with the access method, without checks */
+        ssize_t readProcess(uintptr_t address, void* buffer, size_t size) const;
+
     public:
         /**
          * @brief Memory access method
@@ -36,6 +51,18 @@ namespace fatigue {
          * write before the start or after the end of the region
          */
         bool enforceBounds{true};
+        /**
+         * @brief Size of each read when scanning the region for patterns
+         * @details Pattern scans read the region in chunks of this size into one reusable buffer, so
+         * peak memory does not depend on the region size. Set to 0 to read the whole region at once.
+         */
+        size_t chunkSize{DEFAULT_SCAN_CHUNK_SIZE};
+        /**
+         * @brief Tolerate unreadable pages in read operations
+         * @details If true, read() behaves like readSparse(): pages that cannot be read are zero filled
+         * instead of throwing. Pattern scans always read sparsely and skip the unreadable pages.
+         */
+        bool sparse{false};
 
         /** Name of the region (useful for segments) */
         std::string name;
@@ -65,6 +92,30 @@ namespace fatigue {
             return std::format("{} {:#x}-{:#x} (pid {})", name.c_str(), start, end, pid);
         }
 
+        // Snapshot
+
+        /** Get the attached snapshot, if any */
+        inline std::shared_ptr<RegionSnapshot> snapshot() const { return m_snapshot; }
+        /** Check if a snapshot is attached and up to date */
+        inline bool hasSnapshot() const { return m_snapshot && !m_snapshot->isStale(); }
+
+        /**
+         * @brief Copy the whole region into a new snapshot and attach it
+         * Reads, finds, and copies of this region (e.g. Patch::region()) made after this call will
+         * use the local copy. Call refresh() to re-read it when the process memory may have changed.
+         */
+        std::shared_ptr<RegionSnapshot> takeSnapshot();
+        /** Attach an existing snapshot (e.g. from another copy of this region) */
+        inline void attachSnapshot(std::shared_ptr<RegionSnapshot> snapshot) { m_snapshot = snapshot; }
+        /** Stop using the snapshot (other copies of the region keep it) */
+        inline void detachSnapshot() { m_snapshot = nullptr; }
+
+        /**
+         * @brief Re-read the attached snapshot from process memory
+         * @return false if there is no snapshot, or it could not be fully read
+         */
+        bool refresh() const;
+
         // Read and write
 
         /**
@@ -74,6 +125,17 @@ namespace fatigue {
          * @param size Number of bytes to read
          */
         ssize_t read(ssize_t offset, void* buffer, size_t size) const;
+        /**
+         * @brief Read memory from the region, skipping pages that cannot be read
+         * The range is read in one go if possible; on failure it is split at page boundaries, and
+         * every page that cannot be read (guard pages, unmapped holes) is zero filled and flagged.
+         * @param offset Offset from the start of the region
+         * @param buffer Buffer to read into (always fully written)
+         * @param size Number of bytes to read
+         * @param holes Optional bitmap of the pages that could not be read
+         * @return Number of bytes actually read from the process
+         */
+        ssize_t readSparse(ssize_t offset, void* buffer, size_t size, mem::PageBitmap* holes = nullptr) const;
         /**
          * @brief Write memory to the region
          * @param offset Offset from the start of the region
@@ -82,6 +144,23 @@ namespace fatigue {
          */
         ssize_t write(ssize_t offset, const void* buffer, size_t size) const;
 
+        /**
+         * @brief Read many ranges from the region in as few syscalls as possible
+         * Entries served by the snapshot are copied locally, the rest are batched through
+         * process_vm_readv (for SYS and IO, since reading does not need /proc/pid/mem) or read
+         * one by one with PTRACE, or submitted together with URING. Results are reported per entry
+         * instead of throwing.
+         * @param requests Entries to read; addresses are offsets from the start of the region
+         * @return Number of entries that were read completely
+         */
+        size_t readMany(std::span<mem::ReadRequest> requests) const;
+        /**
+         * @brief Read many absolute addresses of a process, like readMany() over the whole address space
+         * Uses the current access method; nothing is bounds checked.
+         * @return Number of entries that were read completely
+         */
+        static size_t readAbsolute(pid_t pid, std::span<mem::ReadRequest> requests);
+
         /**
          * @brief Read a value from the region
          * @param offset Offset from the start of the region
@@ -106,6 +185,18 @@ namespace fatigue {
 
         // Pattern scanning
 
+        /**
+         * @brief Walk the contents of the region in bounded chunks
+         * Served in one piece from the snapshot if attached, otherwise read chunkSize bytes at a time.
+         * Each chunk starts with the last overlap bytes of the previous one, so anything up to
+         * overlap + 1 bytes long is always seen whole in at least one chunk.
+         * Pages that cannot be read are skipped: the readable parts on either side of a hole are
+         * passed as separate calls, and nothing is carried across a hole.
+         * @param overlap Bytes carried over from the end of each chunk to the start of the next
+         * @param fn Called with the offset of the chunk in the region and its data; return false to stop
+         */
+        void scan(size_t overlap, const std::function<bool(size_t, std::span<const uint8_t>)>& fn) const;
+
         /**
          * Find a pattern in the region using a byte literal and a mask
          * @param pattern Pointer to the byte pattern to search for
@@ -147,5 +238,25 @@ namespace fatigue {
             auto found = find(pattern, true);
             return found.empty() ? 0 : found.front();
         }
+
+        /**
+         * Find several patterns in the region with a single read and a single pass
+         * @param patterns Pattern set compiled into one automaton (empty patterns never match)
+         * @param first If true, return only the first match of each pattern
+         * @return One list of matches per pattern, in the same order as the set
+         * @see fatigue::search::MultiPattern
+         */
+        std::vector<std::vector<uintptr_t>> findAll(const search::MultiPattern& patterns, bool first = false) const;
+
+        /**
+         * Find several patterns in the region with a single read and a single pass
+         * @param patterns Patterns to search for (@see fatigue::search::parsePattern)
+         * @param first If true, return only the first match of each pattern
+         * @return One list of matches per pattern, in the same order as given
+         */
+        inline std::vector<std::vector<uintptr_t>> findAll(std::span<const search::Pattern> patterns, bool first = false) const
+        {
+            return findAll(search::MultiPattern(patterns), first);
+        }
     };
 } // namespace fatigue
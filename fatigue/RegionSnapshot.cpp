@@ -0,0 +1,45 @@
+#include "RegionSnapshot.hpp"
+#include "Region.hpp"
+
+namespace fatigue {
+    bool RegionSnapshot::refresh(const Region& region)
+    {
+        m_stale = true;
+        if (!region.isValid()) return false;
+
+        // Read through a copy without the snapshot, otherwise reads would be served from ourselves
+        Region source = region;
+        source.detachSnapshot();
+
+        m_start = source.start;
+        m_data.resize(source.size());
+
+        if (source.read(0, m_data.data(), m_data.size()) != static_cast<ssize_t>(m_data.size())) {
+            logWarning(std::format("Snapshot of {} is incomplete", source.toString()));
+            return false;
+        }
+
+        m_stale = false;
+        m_generation++;
+        return true;
+    }
+
+    bool RegionSnapshot::read(uintptr_t address, void* buffer, size_t size) const
+    {
+        if (!covers(address, size)) return false;
+        memcpy(buffer, m_data.data() + (address - m_start), size);
+        return true;
+    }
+
+    void RegionSnapshot::update(uintptr_t address, const void* buffer, size_t size)
+    {
+        if (m_stale || !overlaps(address, size)) return;
+
+        if (covers(address, size)) {
+            memcpy(m_data.data() + (address - m_start), buffer, size);
+            m_generation++;
+        } else {
+            invalidate();
+        }
+    }
+} // namespace fatigue
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace fatigue {
+    class Region;
+
+    /**
+     * @brief Local copy of a memory region
+     * Opt-in cache for a Region, so repeated pattern searches and small reads can be served
+     * from local memory instead of a syscall each. Snapshots are shared between copies of a
+     * Region (see Region::takeSnapshot()), and are only re-read on an explicit refresh.
+     * Writes through the owning Region update the cached bytes in place; anything that
+     * cannot be kept consistent invalidates the snapshot instead.
+     */
+    class RegionSnapshot {
+    protected:
+        /** Absolute address in process memory of the first cached byte */
+        uintptr_t m_start{0};
+        std::vector<uint8_t> m_data{};
+        /** Incremented on every refresh and every write-through */
+        uint64_t m_generation{0};
+        bool m_stale{true};
+
+    public:
+        RegionSnapshot() = default;
+        ~RegionSnapshot() = default;
+
+        inline uintptr_t start() const { return m_start; }
+        inline uintptr_t end() const { return m_start + m_data.size(); }
+        inline size_t size() const { return m_data.size(); }
+        inline const uint8_t* data() const { return m_data.data(); }
+        /** Generation counter, compare against a saved value to detect changes */
+        inline uint64_t generation() const { return m_generation; }
+        /** True if never read, or invalidated since the last refresh */
+        inline bool isStale() const { return m_stale; }
+
+        /** Check if an absolute address range is held in the (non-stale) snapshot */
+        inline bool covers(uintptr_t address, size_t size) const
+        {
+            return !m_stale && address >= m_start && address + size <= end();
+        }
+        /** Check if an absolute address range touches the snapshot at all */
+        inline bool overlaps(uintptr_t address, size_t size) const
+        {
+            return address < end() && address + size > m_start;
+        }
+
+        /**
+         * @brief Re-read the whole region into the snapshot
+         * @param region Region to copy (any snapshot attached to it is bypassed)
+         * @return true if the whole region was read
+         */
+        bool refresh(const Region& region);
+
+        /** Mark the snapshot stale, so it is no longer used until refreshed */
+        inline void invalidate() { m_stale = true; }
+
+        /**
+         * @brief Copy cached bytes at an absolute address
+         * @return false (and copies nothing) if the range is not covered
+         */
+        bool read(uintptr_t address, void* buffer, size_t size) const;
+
+        /**
+         * @brief Keep the snapshot consistent after bytes were written to the process
+         * Bytes entirely inside the snapshot are updated in place, a partial overlap invalidates it
+         */
+        void update(uintptr_t address, const void* buffer, size_t size);
+    };
+} // namespace fatigue
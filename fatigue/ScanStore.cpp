@@ -0,0 +1,346 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "log.hpp"
+#include "mem.hpp"
+#include "ScanStore.hpp"
+
+namespace fatigue {
+
+    namespace {
+        const std::string_view s_magic = "MFSCAN01";
+        /** The file grows by doubling, at most this much at a time */
+        const size_t s_maxGrowth = 256 << 20;
+        const size_t s_minCapacity = 1 << 20;
+        /** Release what was read or written from the mapping every this many bytes */
+        const size_t s_releaseBytes = 64 << 20;
+
+        const uint8_t s_zeroFlag = 0x80;
+        const uint8_t s_zeros[ValueScanner::pageBytes]{};
+
+        inline size_t slotsOf(const ScanStoreHeader& header)
+        {
+            size_t size = valueSize(static_cast<ValueType>(header.type));
+            return (ValueScanner::pageBytes - size) / header.alignment + 1;
+        }
+    } // namespace
+
+    ScanStoreWriter::ScanStoreWriter(const std::string& path, const ScanStoreHeader& header)
+        : m_path(path), m_header(header)
+    {
+        memcpy(m_header.magic, s_magic.data(), sizeof(m_header.magic));
+        m_header.pageBytes = ValueScanner::pageBytes;
+        m_header.scans = m_header.pages = m_header.count = m_header.dataSize = 0;
+        m_valueSize = valueSize(static_cast<ValueType>(m_header.type));
+
+        std::error_code error;
+        std::filesystem::path parent = std::filesystem::path(path).parent_path();
+        if (!parent.empty()) std::filesystem::create_directories(parent, error);
+
+        // A new file with a random name (O_EXCL), never one planted there, or a symlink to one
+        std::string temporary = path + ".XXXXXX";
+        m_fd = mkostemp(temporary.data(), O_CLOEXEC);
+        if (m_fd < 0) {
+            logError(std::format("Failed to create scan results {}: {}", temporary, strerror(errno)));
+            return;
+        }
+        m_temporary = temporary;
+
+        // Room for the header, written by commit()
+        if (reserve(sizeof(ScanStoreHeader))) m_size = sizeof(ScanStoreHeader);
+    }
+
+    ScanStoreWriter::~ScanStoreWriter()
+    {
+        close();
+        if (!m_temporary.empty()) {
+            std::error_code error;
+            std::filesystem::remove(m_temporary, error);
+        }
+    }
+
+    void ScanStoreWriter::close()
+    {
+        if (m_data) munmap(m_data, m_capacity);
+        if (m_fd >= 0) ::close(m_fd);
+        m_data = nullptr;
+        m_fd = -1;
+    }
+
+    bool ScanStoreWriter::reserve(size_t size)
+    {
+        if (m_size + size <= m_capacity) return true;
+
+        size_t capacity = std::max({m_capacity + std::min(m_capacity, s_maxGrowth), m_size + size, s_minCapacity});
+        capacity = (capacity + s_minCapacity - 1) & ~(s_minCapacity - 1);
+
+        // Allocate the blocks now: writing past a full disk through the mapping would be a SIGBUS
+        int error = posix_fallocate(m_fd, static_cast<off_t>(m_capacity), static_cast<off_t>(capacity - m_capacity));
+        if (error != 0) {
+            logError(std::format("Failed to grow scan results {} to {} bytes: {}", m_temporary, capacity, strerror(error)));
+            m_failed = true;
+            return false;
+        }
+
+        void* data = m_data ? mremap(m_data, m_capacity, capacity, MREMAP_MAYMOVE)
+                            : mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+        if (data == MAP_FAILED) {
+            logError(std::format("Failed to map scan results {}: {}", m_temporary, strerror(errno)));
+            m_failed = true;
+            return false;
+        }
+
+        m_data = static_cast<uint8_t*>(data);
+        m_capacity = capacity;
+        return true;
+    }
+
+    void ScanStoreWriter::putBytes(const void* data, size_t size)
+    {
+        if (m_failed || !reserve(size)) return;
+        memcpy(m_data + m_size, data, size);
+        m_size += size;
+    }
+
+    void ScanStoreWriter::putVarint(uint64_t value)
+    {
+        uint8_t bytes[10];
+        size_t length = 0;
+        do {
+            bytes[length] = static_cast<uint8_t>(value & 0x7f);
+            value >>= 7;
+            if (value) bytes[length] |= 0x80;
+            length++;
+        } while (value);
+        putBytes(bytes, length);
+    }
+
+    void ScanStoreWriter::release()
+    {
+        if (m_size - m_released < s_releaseBytes) return;
+
+        // Dirty pages of a shared file mapping stay in the page cache, dropping them loses nothing
+        size_t end = m_size & ~(mem::pageSize() - 1);
+        madvise(m_data + m_released, end - m_released, MADV_DONTNEED);
+        m_released = end;
+    }
+
+    bool ScanStoreWriter::write(const ResultPage& page)
+    {
+        if (!isValid()) return false;
+
+        uintptr_t index = page.address / ValueScanner::pageBytes;
+        if (m_header.pages > 0 && index <= m_lastPage) {
+            logError(std::format("Scan results must be written in address order, {:#x} is out of order", page.address));
+            m_failed = true;
+            return false;
+        }
+
+        putVarint(m_header.pages > 0 ? index - m_lastPage : index);
+
+        bool snapshot = page.kind != ResultPage::Kind::Sparse;
+        bool zero = snapshot && memcmp(page.values.data(), s_zeros, ValueScanner::pageBytes) == 0;
+        uint8_t kind = static_cast<uint8_t>(page.kind) | (zero ? s_zeroFlag : 0);
+        putBytes(&kind, 1);
+        putVarint(page.count);
+
+        if (page.kind == ResultPage::Kind::Bitmap) putBytes(page.bitmap.data(), page.bitmap.size() * sizeof(uint64_t));
+        if (snapshot && !zero) putBytes(page.values.data(), ValueScanner::pageBytes);
+
+        if (page.kind == ResultPage::Kind::Sparse) {
+            uint16_t previous = 0;
+            for (uint16_t offset : page.offsets) {
+                putVarint(offset - previous);
+                previous = offset;
+            }
+            putBytes(page.values.data(), page.offsets.size() * m_valueSize);
+        }
+
+        m_lastPage = index;
+        m_header.pages++;
+        m_header.count += page.count;
+        release();
+        return !m_failed;
+    }
+
+    bool ScanStoreWriter::commit(uint64_t scans)
+    {
+        if (!isValid()) {
+            close();
+            return false;
+        }
+
+        m_header.scans = scans;
+        m_header.dataSize = m_size - sizeof(ScanStoreHeader);
+        memcpy(m_data, &m_header, sizeof(ScanStoreHeader));
+
+        // Drop the preallocated tail
+        int fd = m_fd;
+        m_fd = -1;
+        munmap(m_data, m_capacity);
+        m_data = nullptr;
+        bool truncated = ftruncate(fd, static_cast<off_t>(m_size)) == 0;
+        ::close(fd);
+        if (!truncated) {
+            logError(std::format("Failed to write scan results {}: {}", m_temporary, strerror(errno)));
+            return false;
+        }
+
+        std::error_code error;
+        std::filesystem::rename(m_temporary, m_path, error);
+        if (error) {
+            logError(std::format("Failed to save scan results {}: {}", m_path, error.message()));
+            return false;
+        }
+
+        m_temporary.clear();
+        return true;
+    }
+
+    ScanStoreReader::ScanStoreReader(const std::string& path)
+    {
+        m_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (m_fd < 0) {
+            logDebug(std::format("No scan results {}: {}", path, strerror(errno)));
+            return;
+        }
+
+        struct stat info{};
+        if (fstat(m_fd, &info) != 0 || !S_ISREG(info.st_mode) || static_cast<size_t>(info.st_size) < sizeof(ScanStoreHeader)) {
+            logWarning(std::format("Ignoring invalid scan results {}", path));
+            return;
+        }
+
+        // Anyone can write a header with the pid and start time of a process, only trust our own files
+        if (info.st_uid != geteuid()) {
+            logWarning(std::format("Ignoring scan results {}, owned by another user", path));
+            return;
+        }
+
+        m_size = static_cast<size_t>(info.st_size);
+        void* data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, m_fd, 0);
+        if (data == MAP_FAILED) {
+            logError(std::format("Failed to map scan results {}: {}", path, strerror(errno)));
+            return;
+        }
+        m_data = static_cast<const uint8_t*>(data);
+        madvise(const_cast<uint8_t*>(m_data), m_size, MADV_SEQUENTIAL);
+
+        memcpy(&m_header, m_data, sizeof(ScanStoreHeader));
+        m_offset = sizeof(ScanStoreHeader);
+        m_valueSize = valueSize(static_cast<ValueType>(m_header.type));
+
+        if (std::string_view(m_header.magic, sizeof(m_header.magic)) != s_magic || m_header.pageBytes != ValueScanner::pageBytes
+            || m_valueSize == 0 || m_header.alignment == 0 || m_header.alignment > ValueScanner::pageBytes
+            || m_header.dataSize != m_size - sizeof(ScanStoreHeader)) {
+            logWarning(std::format("Ignoring invalid scan results {}", path));
+            m_failed = true;
+            return;
+        }
+
+        m_words = (slotsOf(m_header) + 63) / 64;
+    }
+
+    ScanStoreReader::~ScanStoreReader()
+    {
+        if (m_data) munmap(const_cast<uint8_t*>(m_data), m_size);
+        if (m_fd >= 0) ::close(m_fd);
+    }
+
+    bool ScanStoreReader::getBytes(void* data, size_t size)
+    {
+        if (m_failed || size > m_size - m_offset) {
+            m_failed = true;
+            return false;
+        }
+        memcpy(data, m_data + m_offset, size);
+        m_offset += size;
+        return true;
+    }
+
+    bool ScanStoreReader::getVarint(uint64_t& value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 64 && m_offset < m_size; shift += 7) {
+            uint8_t byte = m_data[m_offset++];
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        m_failed = true;
+        return false;
+    }
+
+    void ScanStoreReader::release()
+    {
+        if (m_offset - m_released < s_releaseBytes) return;
+
+        size_t end = m_offset & ~(mem::pageSize() - 1);
+        madvise(const_cast<uint8_t*>(m_data) + m_released, end - m_released, MADV_DONTNEED);
+        m_released = end;
+    }
+
+    bool ScanStoreReader::next(ResultPage& page)
+    {
+        if (!isValid() || m_read == m_header.pages) return false;
+
+        const size_t slots = slotsOf(m_header);
+        uint64_t delta = 0;
+        uint8_t kind = 0;
+        uint64_t count = 0;
+        if (!getVarint(delta) || !getBytes(&kind, 1) || !getVarint(count)) return false;
+
+        bool zero = kind & s_zeroFlag;
+        kind &= ~s_zeroFlag;
+        if ((m_read > 0 && delta == 0) || kind > static_cast<uint8_t>(ResultPage::Kind::Sparse) || count == 0 || count > slots) {
+            m_failed = true;
+        } else {
+            m_lastPage = m_read > 0 ? m_lastPage + delta : delta;
+            page.address = m_lastPage * ValueScanner::pageBytes;
+            page.kind = static_cast<ResultPage::Kind>(kind);
+            page.count = static_cast<uint32_t>(count);
+            page.bitmap.clear();
+            page.offsets.clear();
+
+            if (page.kind == ResultPage::Kind::Bitmap) {
+                page.bitmap.resize(m_words);
+                getBytes(page.bitmap.data(), m_words * sizeof(uint64_t));
+            }
+
+            if (page.kind != ResultPage::Kind::Sparse) {
+                page.values.resize(ValueScanner::pageBytes);
+                if (zero) {
+                    std::fill(page.values.begin(), page.values.end(), 0);
+                } else {
+                    getBytes(page.values.data(), ValueScanner::pageBytes);
+                }
+            } else {
+                uint64_t offset = 0;
+                page.offsets.reserve(count);
+                for (uint64_t i = 0; i < count && !m_failed; i++) {
+                    uint64_t step = 0;
+                    getVarint(step);
+                    offset += step;
+                    if ((i > 0 && step == 0) || offset > ValueScanner::pageBytes - m_valueSize) m_failed = true;
+                    page.offsets.push_back(static_cast<uint16_t>(offset));
+                }
+                page.values.resize(count * m_valueSize);
+                getBytes(page.values.data(), page.values.size());
+            }
+        }
+
+        if (m_failed) {
+            logError(std::format("Corrupt scan results at offset {}", m_offset));
+            return false;
+        }
+
+        m_read++;
+        release();
+        return true;
+    }
+} // namespace fatigue
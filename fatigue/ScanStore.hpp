@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include "ValueScanner.hpp"
+
+namespace fatigue {
+    /** Fixed header at the start of a scan store file */
+    struct ScanStoreHeader {
+        char magic[8]{};
+        int32_t pid{0};
+        /** ValueType */
+        uint8_t type{0};
+        uint8_t reserved[3]{};
+        uint32_t alignment{0};
+        uint32_t pageBytes{0};
+        /** Start time of the process (@see proc::ProcessInfo), tells a reused pid apart */
+        uint64_t startTime{0};
+        uint64_t scans{0};
+        uint64_t pages{0};
+        uint64_t count{0};
+        /** Bytes of page records after the header */
+        uint64_t dataSize{0};
+    };
+    static_assert(sizeof(ScanStoreHeader) == 64);
+
+    /**
+     * @brief Writes scan results to a memory-mapped file, one page at a time
+     * The file is a ScanStoreHeader followed by one record per ResultPage, in address order:
+     *
+     *     varint  pages since the previous page (the first page: its address / pageBytes)
+     *     u8      kind, | 0x80 if the page snapshot is all zeros (and not stored)
+     *     varint  candidates
+     *     Full:   snapshot (pageBytes)
+     *     Bitmap: bitmap words, snapshot (pageBytes)
+     *     Sparse: varint offset deltas, packed values
+     *
+     * So a run of adjacent pages costs one byte of address each, and the zeroed pages that make up
+     * much of a fresh heap cost a few bytes instead of a page.
+     * Records go to a new file <path>.XXXXXX (mkostemp), which commit() renames over path: a reader
+     * of path sees the old or the new results, never half of them. Written parts of the file are released from the
+     * mapping as it grows, so memory use stays bounded however large the results get.
+     */
+    class ScanStoreWriter {
+    protected:
+        std::string m_path{};
+        std::string m_temporary{};
+        int m_fd{-1};
+        uint8_t* m_data{nullptr};
+        size_t m_size{0};
+        size_t m_capacity{0};
+        /** Start of the part of the mapping that is not yet released */
+        size_t m_released{0};
+        ScanStoreHeader m_header{};
+        size_t m_valueSize{0};
+        uintptr_t m_lastPage{0};
+        bool m_failed{false};
+
+        /** Make room for size more bytes */
+        bool reserve(size_t size);
+        void putVarint(uint64_t value);
+        void putBytes(const void* data, size_t size);
+        void release();
+        void close();
+
+    public:
+        /**
+         * @param path File to replace on commit()
+         * @param header Process, type and alignment of the results (counts are filled in)
+         */
+        ScanStoreWriter(const std::string& path, const ScanStoreHeader& header);
+        ~ScanStoreWriter();
+
+        ScanStoreWriter(const ScanStoreWriter&) = delete;
+        ScanStoreWriter& operator=(const ScanStoreWriter&) = delete;
+
+        /** Check if the file could be created and nothing failed since */
+        inline bool isValid() const { return m_fd >= 0 && !m_failed; }
+        inline uint64_t pages() const { return m_header.pages; }
+        inline uint64_t count() const { return m_header.count; }
+
+        /** Append a page, pages must come in increasing address order */
+        bool write(const ResultPage& page);
+        /** Finish the file and rename it over the destination */
+        bool commit(uint64_t scans);
+    };
+
+    /**
+     * @brief Streams the pages of a scan store file (@see ScanStoreWriter)
+     * Files owned by another user are ignored. The file is mapped read-only and read front to back; what was read is released from the
+     * mapping as the reader moves on.
+     */
+    class ScanStoreReader {
+    protected:
+        int m_fd{-1};
+        const uint8_t* m_data{nullptr};
+        size_t m_size{0};
+        size_t m_offset{0};
+        size_t m_released{0};
+        ScanStoreHeader m_header{};
+        size_t m_valueSize{0};
+        size_t m_words{0};
+        uintptr_t m_lastPage{0};
+        uint64_t m_read{0};
+        bool m_failed{false};
+
+        bool getVarint(uint64_t& value);
+        bool getBytes(void* data, size_t size);
+        void release();
+
+    public:
+        explicit ScanStoreReader(const std::string& path);
+        ~ScanStoreReader();
+
+        ScanStoreReader(const ScanStoreReader&) = delete;
+        ScanStoreReader& operator=(const ScanStoreReader&) = delete;
+
+        /** Check if the file has a valid header, and no record was found corrupt */
+        inline bool isValid() const { return m_data != nullptr && !m_failed; }
+        inline const ScanStoreHeader& header() const { return m_header; }
+
+        /**
+         * Read the next page, reusing the storage of the page passed in
+         * @return false at the end of the file, or if it is corrupt (then isValid() is false)
+         */
+        bool next(ResultPage& page);
+    };
+} // namespace fatigue
@@ -0,0 +1,164 @@
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+#include "SignatureCache.hpp"
+
+namespace fatigue {
+
+    namespace {
+        const std::string_view s_header = "memoryfatigue signatures 1";
+    } // namespace
+
+    SignatureCache::SignatureCache(const pe::PeMap& module, const std::string& directory)
+    {
+        m_key = moduleKey(module);
+        if (m_key == 0) {
+            logWarning(std::format("Signature cache disabled, invalid PE headers for {}", module.name));
+            return;
+        }
+
+        m_base = module.start;
+        m_end = module.start + std::max<uint64_t>(module.optional().sizeOfImage, module.size());
+
+        std::string base = directory.empty() ? defaultDirectory() : directory;
+        if (base.empty()) {
+            logDebug("Signature cache disabled, no cache directory");
+            return;
+        }
+
+        m_name = std::filesystem::path(module.name).filename().string();
+        if (m_name.empty()) m_name = "module";
+        m_path = (std::filesystem::path(base) / std::format("{}-{:016x}.cache", string::toLower(m_name), m_key)).string();
+
+        load();
+    }
+
+    SignatureCache::~SignatureCache()
+    {
+        save();
+    }
+
+    std::string SignatureCache::defaultDirectory()
+    {
+        const char* cache = getenv("XDG_CACHE_HOME");
+        if (cache && cache[0] == '/') return (std::filesystem::path(cache) / "memoryfatigue").string();
+
+        const char* home = getenv("HOME");
+        if (home && home[0] == '/') return (std::filesystem::path(home) / ".cache" / "memoryfatigue").string();
+
+        return "";
+    }
+
+    uint64_t SignatureCache::moduleKey(const pe::PeMap& module)
+    {
+        // The headers alone tell builds apart, and hashing them is a single small read
+        return module.fingerprint();
+    }
+
+    void SignatureCache::load()
+    {
+        std::ifstream file(m_path);
+        if (!file.is_open()) return;
+
+        std::string line;
+        if (!std::getline(file, line) || line != s_header) {
+            logWarning(std::format("Ignoring signature cache with unknown format: {}", m_path));
+            return;
+        }
+
+        // 0x<rva> <pattern>
+        while (std::getline(file, line)) {
+            size_t space = line.find(' ');
+            if (space == std::string::npos || space + 1 >= line.size() || !line.starts_with("0x")) continue;
+
+            uint32_t rva = 0;
+            auto [end, error] = std::from_chars(line.data() + 2, line.data() + space, rva, 16);
+            if (error != std::errc{} || end != line.data() + space) continue;
+
+            m_entries.insert_or_assign(line.substr(space + 1), rva);
+        }
+
+        logDebug(std::format("Loaded {} cached signatures from {}", m_entries.size(), m_path));
+    }
+
+    bool SignatureCache::save()
+    {
+        if (!isValid() || !m_dirty) return true;
+
+        std::error_code error;
+        std::filesystem::path path(m_path);
+        std::filesystem::create_directories(path.parent_path(), error);
+        if (error) {
+            logWarning(std::format("Failed to create signature cache directory {}: {}", path.parent_path().string(), error.message()));
+            return false;
+        }
+
+        // Write next to the destination and rename over it, readers see the old or the new file
+        std::string temporary = std::format("{}.{}.tmp", m_path, getpid());
+        {
+            std::ofstream file(temporary, std::ios::trunc);
+            file << s_header << '\n';
+            for (const auto& [pattern, rva] : m_entries) {
+                file << std::format("{:#x} {}\n", rva, pattern);
+            }
+            if (!file.good()) {
+                logWarning(std::format("Failed to write signature cache {}", temporary));
+                std::filesystem::remove(temporary, error);
+                return false;
+            }
+        }
+
+        std::filesystem::rename(temporary, path, error);
+        if (error) {
+            logWarning(std::format("Failed to save signature cache {}: {}", m_path, error.message()));
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+
+        m_dirty = false;
+        return true;
+    }
+
+    bool SignatureCache::lookup(std::string_view pattern, const Region& region, uintptr_t& offset) const
+    {
+        if (!isValid() || !covers(region)) return false;
+
+        auto found = m_entries.find(pattern);
+        if (found == m_entries.end()) return false;
+
+        uintptr_t address = m_base + found->second;
+        if (!region.contains(address)) return false;
+
+        offset = address - region.start;
+        return true;
+    }
+
+    void SignatureCache::store(std::string_view pattern, const Region& region, uintptr_t offset)
+    {
+        if (!isValid() || !covers(region) || pattern.empty()) return;
+
+        // One pattern per line, a newline would break the file format
+        if (pattern.find('\n') != std::string_view::npos) return;
+
+        uint32_t rva = static_cast<uint32_t>(region.start + offset - m_base);
+        auto found = m_entries.find(pattern);
+        if (found != m_entries.end()) {
+            if (found->second == rva) return;
+            found->second = rva;
+        } else {
+            m_entries.emplace(std::string(pattern), rva);
+        }
+        m_dirty = true;
+    }
+
+    void SignatureCache::erase(std::string_view pattern)
+    {
+        auto found = m_entries.find(pattern);
+        if (found == m_entries.end()) return;
+        m_entries.erase(found);
+        m_dirty = true;
+    }
+} // namespace fatigue
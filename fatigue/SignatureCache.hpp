@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "pe.hpp"
+#include "Region.hpp"
+
+namespace fatigue {
+    /**
+     * @brief Persistent cache of pattern matches for one module
+     * Maps pattern strings to the RVA (offset from the module base) of their first match, and is
+     * stored on disk per module identity: a fingerprint of the PE headers (timestamp, SizeOfImage,
+     * checksum, section table, ...). A rebuilt exe gets a different file, so stale entries are never
+     * even read.
+     * Patch::find() asks the cache first and only verifies the bytes at the cached RVA (one small
+     * read); if they no longer match, it falls back to a full scan and updates the entry.
+     * Files live in $XDG_CACHE_HOME/memoryfatigue (or ~/.cache/memoryfatigue).
+     * @see Patch::setSignatureCache()
+     */
+    class SignatureCache {
+    protected:
+        std::string m_path{};
+        std::string m_name{};
+        uintptr_t m_base{0};
+        uintptr_t m_end{0};
+        uint64_t m_key{0};
+        std::unordered_map<std::string, uint32_t, pe::StringHash, std::equal_to<>> m_entries{};
+        bool m_dirty{false};
+
+        void load();
+
+    public:
+        /**
+         * @param module Loaded image the patterns are searched in
+         * @param directory Where cache files are kept, defaults to defaultDirectory()
+         */
+        explicit SignatureCache(const pe::PeMap& module, const std::string& directory = "");
+        ~SignatureCache();
+
+        SignatureCache(const SignatureCache&) = delete;
+        SignatureCache& operator=(const SignatureCache&) = delete;
+
+        /** Get $XDG_CACHE_HOME/memoryfatigue, or ~/.cache/memoryfatigue, empty if neither is set */
+        static std::string defaultDirectory();
+        /** Compute the identity of a module from its headers, 0 if the headers are not valid (@see pe::PeMap::fingerprint) */
+        static uint64_t moduleKey(const pe::PeMap& module);
+
+        inline bool isValid() const { return m_key != 0 && !m_path.empty(); }
+        inline const std::string& path() const { return m_path; }
+        inline uint64_t key() const { return m_key; }
+        inline size_t size() const { return m_entries.size(); }
+        inline bool empty() const { return m_entries.empty(); }
+
+        /** Check if a region lies inside the module, so its matches can be cached */
+        inline bool covers(const Region& region) const
+        {
+            return region.pid > 0 && region.start >= m_base && region.end <= m_end;
+        }
+
+        /**
+         * Get the cached match of a pattern as an offset into a region
+         * @return false if not cached, or if the cached match is outside the region
+         */
+        bool lookup(std::string_view pattern, const Region& region, uintptr_t& offset) const;
+        /** Remember the match of a pattern, given as an offset into a region inside the module */
+        void store(std::string_view pattern, const Region& region, uintptr_t offset);
+        /** Forget a pattern, e.g. when the bytes at its cached match no longer match */
+        void erase(std::string_view pattern);
+
+        /**
+         * Write the cache to disk if anything changed (also done on destruction)
+         * The file is replaced atomically, so concurrent patchers never see a partial file
+         */
+        bool save();
+    };
+} // namespace fatigue
@@ -0,0 +1,700 @@
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <type_traits>
+#include "log.hpp"
+#include "ProcessScanner.hpp"
+#include "ScanStore.hpp"
+#include "SignatureCache.hpp"
+#include "ValueScanner.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FATIGUE_SCANNER_X86 1
+#else
+#define FATIGUE_SCANNER_X86 0
+#endif
+
+namespace fatigue {
+
+    namespace {
+        struct TypeInfo {
+            ValueType type;
+            std::string_view name;
+            size_t size;
+        };
+
+        const TypeInfo s_types[] = {
+            {ValueType::Int8, "int8", 1},     {ValueType::Int16, "int16", 2},   {ValueType::Int32, "int32", 4},
+            {ValueType::Int64, "int64", 8},   {ValueType::UInt8, "uint8", 1},   {ValueType::UInt16, "uint16", 2},
+            {ValueType::UInt32, "uint32", 4}, {ValueType::UInt64, "uint64", 8}, {ValueType::Float, "float", 4},
+            {ValueType::Double, "double", 8},
+        };
+
+        const std::pair<std::string_view, ScanMode> s_modes[] = {
+            {"exact", ScanMode::Exact},         {"range", ScanMode::Range},
+            {"unknown", ScanMode::Unknown},     {"changed", ScanMode::Changed},
+            {"unchanged", ScanMode::Unchanged}, {"increased", ScanMode::Increased},
+            {"decreased", ScanMode::Decreased},
+        };
+
+        /** Call fn.template operator()<T>() with the C++ type of a value type */
+        template <typename Fn>
+        inline void withType(ValueType type, Fn&& fn)
+        {
+            switch (type) {
+            case ValueType::Int8: fn.template operator()<int8_t>(); break;
+            case ValueType::Int16: fn.template operator()<int16_t>(); break;
+            case ValueType::Int32: fn.template operator()<int32_t>(); break;
+            case ValueType::Int64: fn.template operator()<int64_t>(); break;
+            case ValueType::UInt8: fn.template operator()<uint8_t>(); break;
+            case ValueType::UInt16: fn.template operator()<uint16_t>(); break;
+            case ValueType::UInt32: fn.template operator()<uint32_t>(); break;
+            case ValueType::UInt64: fn.template operator()<uint64_t>(); break;
+            case ValueType::Float: fn.template operator()<float>(); break;
+            case ValueType::Double: fn.template operator()<double>(); break;
+            }
+        }
+
+        /** Call fn.template operator()<Mode>() with a scan mode as a constant */
+        template <typename Fn>
+        inline void withMode(ScanMode mode, Fn&& fn)
+        {
+            switch (mode) {
+            case ScanMode::Exact: fn.template operator()<ScanMode::Exact>(); break;
+            case ScanMode::Range: fn.template operator()<ScanMode::Range>(); break;
+            case ScanMode::Changed: fn.template operator()<ScanMode::Changed>(); break;
+            case ScanMode::Unchanged: fn.template operator()<ScanMode::Unchanged>(); break;
+            case ScanMode::Increased: fn.template operator()<ScanMode::Increased>(); break;
+            case ScanMode::Decreased: fn.template operator()<ScanMode::Decreased>(); break;
+            case ScanMode::Unknown: break;
+            }
+        }
+
+        /** Changed and Unchanged compare the bits, so that NaN is unchanged and -0.0 changed from 0.0 */
+        template <typename T, ScanMode Mode>
+        using CompareType = std::conditional_t<Mode == ScanMode::Changed || Mode == ScanMode::Unchanged,
+                                               std::conditional_t<sizeof(T) == 1, uint8_t,
+                                               std::conditional_t<sizeof(T) == 2, uint16_t,
+                                               std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>>>,
+                                               T>;
+
+        template <typename T, ScanMode Mode>
+        inline bool keep(const uint8_t* current, const uint8_t* previous, T a, T b)
+        {
+            T value;
+            memcpy(&value, current, sizeof(T));
+
+            if constexpr (Mode == ScanMode::Exact) {
+                return value == a;
+            } else if constexpr (Mode == ScanMode::Range) {
+                return value >= a && value <= b;
+            } else {
+                T last;
+                memcpy(&last, previous, sizeof(T));
+                if constexpr (Mode == ScanMode::Changed) return value != last;
+                if constexpr (Mode == ScanMode::Unchanged) return value == last;
+                if constexpr (Mode == ScanMode::Increased) return value > last;
+                if constexpr (Mode == ScanMode::Decreased) return value < last;
+            }
+        }
+
+        /** Scalar filter, for slots that are not aligned to the value size */
+        template <typename T, ScanMode Mode>
+        void filterScalar(const uint8_t* current, const uint8_t* previous, T a, T b, size_t alignment, uint64_t* bits, size_t words)
+        {
+            for (size_t word = 0; word < words; word++) {
+                uint64_t mask = bits[word];
+                while (mask) {
+                    const uint64_t bit = mask & -mask;
+                    size_t offset = (word * 64 + std::countr_zero(mask)) * alignment;
+                    if (!keep<T, Mode>(current + offset, previous + offset, a, b)) bits[word] &= ~bit;
+                    mask &= mask - 1;
+                }
+            }
+        }
+
+        /**
+         * Vector filter over a page of aligned values, Width bytes at a time
+         * Built on GCC vector extensions, so the same code becomes SSE2 or AVX2 compares depending on
+         * the target of the function it is inlined in. Lanes that fail clear their bit; groups with
+         * no candidate left are skipped without being loaded.
+         */
+        template <size_t Width, typename T, ScanMode Mode>
+        __attribute__((always_inline)) inline void filterVector(const uint8_t* current, const uint8_t* previous, T a, T b, uint64_t* bits, size_t slots)
+        {
+            typedef T Vector __attribute__((vector_size(Width)));
+            constexpr size_t lanes = Width / sizeof(T);
+            static_assert(64 % lanes == 0);
+
+            Vector low{};
+            Vector high{};
+            for (size_t lane = 0; lane < lanes; lane++) {
+                low[lane] = a;
+                high[lane] = b;
+            }
+
+            for (size_t slot = 0; slot + lanes <= slots; slot += lanes) {
+                uint64_t& word = bits[slot / 64];
+                const uint64_t group = (lanes == 64 ? ~0ull : (1ull << lanes) - 1) << (slot % 64);
+                if (!(word & group)) continue;
+
+                Vector value;
+                memcpy(&value, current + slot * sizeof(T), Width);
+
+                decltype(value == value) pass;
+                if constexpr (Mode == ScanMode::Exact) {
+                    pass = value == low;
+                } else if constexpr (Mode == ScanMode::Range) {
+                    pass = (value >= low) & (value <= high);
+                } else {
+                    Vector last;
+                    memcpy(&last, previous + slot * sizeof(T), Width);
+                    if constexpr (Mode == ScanMode::Changed) pass = value != last;
+                    if constexpr (Mode == ScanMode::Unchanged) pass = value == last;
+                    if constexpr (Mode == ScanMode::Increased) pass = value > last;
+                    if constexpr (Mode == ScanMode::Decreased) pass = value < last;
+                }
+
+                uint64_t kept = 0;
+                for (size_t lane = 0; lane < lanes; lane++) kept |= static_cast<uint64_t>(pass[lane] != 0) << lane;
+                word &= ~group | kept << (slot % 64);
+            }
+        }
+
+        template <typename T, ScanMode Mode>
+        void filterBaseline(const uint8_t* current, const uint8_t* previous, T a, T b, uint64_t* bits, size_t slots)
+        {
+            filterVector<16, T, Mode>(current, previous, a, b, bits, slots);
+        }
+
+#if FATIGUE_SCANNER_X86
+        template <typename T, ScanMode Mode>
+        __attribute__((target("avx2"))) void filterAvx2(const uint8_t* current, const uint8_t* previous, T a, T b, uint64_t* bits, size_t slots)
+        {
+            filterVector<32, T, Mode>(current, previous, a, b, bits, slots);
+        }
+#endif
+
+        /** Header of the store files of a scanner */
+        inline ScanStoreHeader storeHeader(const ValueScanner& scanner)
+        {
+            ScanStoreHeader header;
+            header.pid = scanner.pid();
+            header.type = static_cast<uint8_t>(scanner.type());
+            header.alignment = static_cast<uint32_t>(scanner.alignment());
+            header.startTime = proc::getProcessInfo(scanner.pid()).startTime;
+            return header;
+        }
+    } // namespace
+
+    size_t valueSize(ValueType type)
+    {
+        for (const TypeInfo& info : s_types) {
+            if (info.type == type) return info.size;
+        }
+        return 0;
+    }
+
+    std::string_view valueTypeName(ValueType type)
+    {
+        for (const TypeInfo& info : s_types) {
+            if (info.type == type) return info.name;
+        }
+        return "";
+    }
+
+    bool parseValueType(std::string_view name, ValueType& type)
+    {
+        std::string lower = string::toLower(string::trim(name));
+        for (const TypeInfo& info : s_types) {
+            if (info.name == lower) {
+                type = info.type;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool parseScanMode(std::string_view name, ScanMode& mode)
+    {
+        std::string lower = string::toLower(string::trim(name));
+        for (const auto& [text, value] : s_modes) {
+            if (text == lower) {
+                mode = value;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool ScanValue::parse(ValueType type, std::string_view text, ScanValue& value)
+    {
+        bool parsed = false;
+        withType(type, [&]<typename T>() {
+            T number{};
+            parsed = string::parseNumber(text, number);
+            if (parsed) value = ScanValue::of(number);
+        });
+        return parsed;
+    }
+
+    std::string ScanValue::format(ValueType type, const void* data)
+    {
+        std::string text;
+        withType(type, [&]<typename T>() {
+            T number;
+            memcpy(&number, data, sizeof(T));
+            // Print 8-bit values as numbers, not characters
+            if constexpr (sizeof(T) == 1) {
+                text = std::to_string(static_cast<int>(number));
+            } else {
+                text = std::format("{}", number);
+            }
+        });
+        return text;
+    }
+
+    ValueScanner::ValueScanner(pid_t pid, ValueType type, size_t alignment)
+        : m_pid(pid), m_type(type), m_size(fatigue::valueSize(type)), m_alignment(alignment ? alignment : m_size)
+    {
+    }
+
+    std::string ValueScanner::defaultStorePath(pid_t pid)
+    {
+        // Somewhere only this user can write, so nobody else can plant results or a symlink there
+        std::filesystem::path directory;
+        const char* runtime = getenv("XDG_RUNTIME_DIR");
+        if (runtime && runtime[0] == '/') directory = std::filesystem::path(runtime) / "memoryfatigue";
+        if (directory.empty()) directory = SignatureCache::defaultDirectory();
+
+        if (directory.empty()) {
+            std::error_code error;
+            directory = std::filesystem::temp_directory_path(error);
+            if (error) directory = "/tmp";
+            return (directory / std::format("memoryfatigue-scan-{}.bin", pid)).string();
+        }
+        return (directory / std::format("scan-{}.bin", pid)).string();
+    }
+
+    bool ValueScanner::useStore(const std::string& path)
+    {
+        m_pages.clear();
+        m_pages.shrink_to_fit();
+        m_scans = 0;
+        m_storedPages = m_storedCount = 0;
+        m_storePath = path;
+
+        ScanStoreReader reader(path);
+        if (!reader.isValid()) return false;
+
+        // Results of another process (or of a pid since reused), type or alignment start over
+        const ScanStoreHeader& header = reader.header();
+        if (header.pid != m_pid || header.startTime != proc::getProcessInfo(m_pid).startTime
+            || header.type != static_cast<uint8_t>(m_type) || header.alignment != m_alignment) {
+            logInfo(std::format("Scan results {} are for another process or type, starting over", path));
+            return false;
+        }
+
+        m_scans = header.scans;
+        m_storedPages = header.pages;
+        m_storedCount = header.count;
+        return m_scans > 0;
+    }
+
+    size_t ValueScanner::count() const
+    {
+        if (isStored()) return m_storedCount;
+
+        size_t total = 0;
+        for (const ResultPage& page : m_pages) total += page.count;
+        return total;
+    }
+
+    size_t ValueScanner::pageCount() const
+    {
+        return isStored() ? m_storedPages : m_pages.size();
+    }
+
+    size_t ValueScanner::memoryUsage() const
+    {
+        size_t total = m_pages.capacity() * sizeof(ResultPage);
+        for (const ResultPage& page : m_pages) total += page.memoryUsage() - sizeof(ResultPage);
+        return total;
+    }
+
+    void ValueScanner::reset()
+    {
+        m_pages.clear();
+        m_pages.shrink_to_fit();
+        m_scans = 0;
+
+        if (isStored()) {
+            std::error_code error;
+            std::filesystem::remove(m_storePath, error);
+            m_storedPages = m_storedCount = 0;
+        }
+    }
+
+    std::vector<Region> ValueScanner::scanRegions() const
+    {
+        std::vector<Region> regions;
+        if (!m_regions.empty()) {
+            regions = m_regions;
+        } else {
+            proc::MapIndex maps(m_pid, false);
+            for (const proc::MapIndex::Entry* entry : maps.filter(m_perms)) {
+                regions.emplace_back(m_pid, entry->map.start, entry->map.end);
+            }
+        }
+
+        // Results are kept per page, drop the partial pages at both ends
+        std::vector<Region> trimmed;
+        for (const Region& region : regions) {
+            uintptr_t start = (region.start + pageBytes - 1) & ~(pageBytes - 1);
+            uintptr_t end = region.end & ~(pageBytes - 1);
+            if (start >= end) continue;
+
+            Region page(region.pid, start, end);
+            page.chunkSize = std::max(region.chunkSize & ~(pageBytes - 1), pageBytes);
+            trimmed.push_back(std::move(page));
+        }
+
+        // Pages are produced in address order, which the store relies on
+        std::sort(trimmed.begin(), trimmed.end(), [](const Region& left, const Region& right) {
+            return left.start < right.start;
+        });
+        return trimmed;
+    }
+
+    void ValueScanner::filter(ScanMode mode, const uint8_t* current, const uint8_t* previous, const ScanValue& a, const ScanValue& b, std::vector<uint64_t>& bits) const
+    {
+        const size_t count = slots();
+        const bool aligned = m_alignment == m_size;
+#if FATIGUE_SCANNER_X86
+        const bool avx2 = search::resolveEngine(search::getEngine()) == search::Engine::AVX2;
+#endif
+
+        withType(m_type, [&]<typename T>() {
+            withMode(mode, [&]<ScanMode Mode>() {
+                using C = CompareType<T, Mode>;
+                C low = a.as<C>();
+                C high = b.as<C>();
+
+                if (!aligned) {
+                    filterScalar<C, Mode>(current, previous, low, high, m_alignment, bits.data(), bits.size());
+                    return;
+                }
+#if FATIGUE_SCANNER_X86
+                if (avx2) {
+                    filterAvx2<C, Mode>(current, previous, low, high, bits.data(), count);
+                    return;
+                }
+#endif
+                filterBaseline<C, Mode>(current, previous, low, high, bits.data(), count);
+            });
+        });
+    }
+
+    bool ValueScanner::store(ResultPage& page, std::vector<uint64_t>& bits, const uint8_t* data) const
+    {
+        const size_t total = slots();
+        size_t count = 0;
+        for (uint64_t word : bits) count += std::popcount(word);
+
+        page.count = static_cast<uint32_t>(count);
+        page.bitmap.clear();
+        page.offsets.clear();
+        if (count == 0) {
+            page.values.clear();
+            return false;
+        }
+
+        if (count == total) {
+            page.kind = ResultPage::Kind::Full;
+            page.values.assign(data, data + pageBytes);
+        } else if (count * (sizeof(uint16_t) + m_size) < bits.size() * sizeof(uint64_t) + pageBytes) {
+            // Few candidates: their offsets and values are smaller than a bitmap and a page
+            page.kind = ResultPage::Kind::Sparse;
+            page.offsets.reserve(count);
+            page.values.resize(count * m_size);
+            uint8_t* value = page.values.data();
+            for (size_t word = 0; word < bits.size(); word++) {
+                for (uint64_t mask = bits.at(word); mask; mask &= mask - 1) {
+                    uint16_t offset = static_cast<uint16_t>((word * 64 + std::countr_zero(mask)) * m_alignment);
+                    page.offsets.push_back(offset);
+                    memcpy(value, data + offset, m_size);
+                    value += m_size;
+                }
+            }
+        } else {
+            page.kind = ResultPage::Kind::Bitmap;
+            page.bitmap = bits;
+            page.values.assign(data, data + pageBytes);
+        }
+
+        page.bitmap.shrink_to_fit();
+        page.offsets.shrink_to_fit();
+        page.values.shrink_to_fit();
+        return true;
+    }
+
+    bool ValueScanner::update(ResultPage& page, ScanMode mode, const uint8_t* current, const ScanValue& a, const ScanValue& b) const
+    {
+        if (page.kind != ResultPage::Kind::Sparse) {
+            std::vector<uint64_t> bits;
+            if (page.kind == ResultPage::Kind::Full) {
+                const size_t total = slots();
+                bits.assign((total + 63) / 64, ~0ull);
+                if (total % 64) bits.back() = (1ull << (total % 64)) - 1;
+            } else {
+                bits = std::move(page.bitmap);
+            }
+            filter(mode, current, page.values.data(), a, b, bits);
+            return store(page, bits, current);
+        }
+
+        // Sparse pages compare their candidates one by one, keeping the survivors in place
+        size_t kept = 0;
+        withType(m_type, [&]<typename T>() {
+            withMode(mode, [&]<ScanMode Mode>() {
+                using C = CompareType<T, Mode>;
+                C low = a.as<C>();
+                C high = b.as<C>();
+
+                for (size_t i = 0; i < page.offsets.size(); i++) {
+                    uint16_t offset = page.offsets.at(i);
+                    if (!keep<C, Mode>(current + offset, page.values.data() + i * m_size, low, high)) continue;
+
+                    page.offsets.at(kept) = offset;
+                    memcpy(page.values.data() + kept * m_size, current + offset, m_size);
+                    kept++;
+                }
+            });
+        });
+
+        page.count = static_cast<uint32_t>(kept);
+        page.offsets.resize(kept);
+        page.values.resize(kept * m_size);
+        return kept > 0;
+    }
+
+    bool ValueScanner::firstScan(ScanMode mode, const ScanValue& a, const ScanValue& b)
+    {
+        if (mode != ScanMode::Exact && mode != ScanMode::Range && mode != ScanMode::Unknown) {
+            logError(std::format("A first scan must be exact, range or unknown"));
+            return false;
+        }
+
+        // The previous results file stays until the new one is committed over it, so a scan that
+        // fails (or is interrupted) leaves the previous results intact
+        std::unique_ptr<ScanStoreWriter> writer;
+        if (isStored()) {
+            writer = std::make_unique<ScanStoreWriter>(m_storePath, storeHeader(*this));
+            if (!writer->isValid()) return false;
+        } else {
+            reset();
+        }
+
+        const size_t total = slots();
+        std::vector<uint64_t> all((total + 63) / 64, ~0ull);
+        if (total % 64) all.back() = (1ull << (total % 64)) - 1;
+
+        std::vector<uint64_t> bits;
+        ResultPage page;
+        size_t scanned = 0;
+        bool failed = false;
+        for (const Region& region : scanRegions()) {
+            region.scan(0, [&](size_t offset, std::span<const uint8_t> data) {
+                uintptr_t address = region.start + offset;
+                size_t skip = (pageBytes - address % pageBytes) % pageBytes;
+
+                for (size_t position = skip; position + pageBytes <= data.size(); position += pageBytes) {
+                    const uint8_t* contents = data.data() + position;
+                    bits = all;
+                    if (mode != ScanMode::Unknown) filter(mode, contents, nullptr, a, b, bits);
+                    scanned++;
+
+                    page.address = address + position;
+                    if (!store(page, bits, contents)) continue;
+
+                    if (writer) {
+                        failed = !writer->write(page);
+                        if (failed) return false;
+                    } else {
+                        m_pages.push_back(std::move(page));
+                        page = {};
+                    }
+                }
+                return true;
+            });
+            if (failed) return false;
+        }
+
+        if (writer) {
+            if (!writer->commit(1)) return false;
+            m_storedPages = writer->pages();
+            m_storedCount = writer->count();
+        }
+
+        m_scans = 1;
+        logDebug(std::format("First scan of {} pages: {} candidates on {} pages, {} bytes", scanned, count(), pageCount(), memoryUsage()));
+        return true;
+    }
+
+    size_t ValueScanner::updateBatch(std::span<ResultPage> pages, ScanMode mode, const ScanValue& a, const ScanValue& b, std::vector<uint8_t>& buffer) const
+    {
+        buffer.resize(pages.size() * pageBytes);
+
+        // Adjacent pages are read with one request
+        std::vector<mem::ReadRequest> requests;
+        std::vector<size_t> firstPage;
+        for (size_t i = 0; i < pages.size(); i++) {
+            if (!requests.empty() && pages[i].address == pages[i - 1].address + pageBytes) {
+                requests.back().size += pageBytes;
+            } else {
+                requests.push_back({.address = pages[i].address, .buffer = buffer.data() + i * pageBytes, .size = pageBytes});
+                firstPage.push_back(i);
+            }
+        }
+        // A read stops at the first page it cannot read, so read the rest of that run again from the
+        // page after it (like Region::readSparse), until every page was either read or failed itself
+        std::vector<uint8_t> readable(pages.size(), 0);
+        while (!requests.empty()) {
+            Region::readAbsolute(m_pid, requests);
+
+            std::vector<mem::ReadRequest> rest;
+            std::vector<size_t> restFirst;
+            for (size_t r = 0; r < requests.size(); r++) {
+                const mem::ReadRequest& request = requests.at(r);
+                const size_t count = request.size / pageBytes;
+                const size_t read = std::min(request.bytesRead / pageBytes, count);
+                std::fill_n(readable.begin() + firstPage.at(r), read, 1);
+
+                if (read + 1 < count) {
+                    size_t skip = (read + 1) * pageBytes;
+                    rest.push_back({.address = request.address + skip, .buffer = static_cast<uint8_t*>(request.buffer) + skip, .size = request.size - skip});
+                    restFirst.push_back(firstPage.at(r) + read + 1);
+                }
+            }
+            requests = std::move(rest);
+            firstPage = std::move(restFirst);
+        }
+
+        size_t kept = 0;
+        for (size_t i = 0; i < pages.size(); i++) {
+            // Pages that were unmapped (or became unreadable) lose their candidates
+            if (!readable.at(i)) continue;
+            if (!update(pages[i], mode, buffer.data() + i * pageBytes, a, b)) continue;
+
+            if (kept != i) std::swap(pages[kept], pages[i]);
+            kept++;
+        }
+        return kept;
+    }
+
+    bool ValueScanner::nextScan(ScanMode mode, const ScanValue& a, const ScanValue& b)
+    {
+        if (m_scans == 0) {
+            logError("Next scan without a first scan");
+            return false;
+        }
+        if (mode == ScanMode::Unknown) {
+            logError("A next scan cannot be unknown");
+            return false;
+        }
+
+        std::vector<uint8_t> buffer;
+
+        if (!isStored()) {
+            size_t kept = 0;
+            for (size_t batch = 0; batch < m_pages.size(); batch += batchPages) {
+                std::span<ResultPage> pages(m_pages.data() + batch, std::min(batchPages, m_pages.size() - batch));
+                size_t survivors = updateBatch(pages, mode, a, b, buffer);
+                for (size_t i = 0; i < survivors; i++) {
+                    if (kept != batch + i) m_pages.at(kept) = std::move(pages[i]);
+                    kept++;
+                }
+            }
+            m_pages.resize(kept);
+            m_pages.shrink_to_fit();
+        } else {
+            // Stream the stored pages a batch at a time into the next file
+            ScanStoreReader reader(m_storePath);
+            ScanStoreWriter writer(m_storePath, storeHeader(*this));
+            if (!reader.isValid() || !writer.isValid()) return false;
+
+            std::vector<ResultPage> pages(batchPages);
+            while (true) {
+                size_t read = 0;
+                while (read < pages.size() && reader.next(pages.at(read))) read++;
+                if (read == 0) break;
+
+                size_t survivors = updateBatch({pages.data(), read}, mode, a, b, buffer);
+                for (size_t i = 0; i < survivors; i++) {
+                    if (!writer.write(pages.at(i))) return false;
+                }
+            }
+            if (!reader.isValid() || !writer.commit(m_scans + 1)) return false;
+
+            m_storedPages = writer.pages();
+            m_storedCount = writer.count();
+        }
+
+        m_scans++;
+        logDebug(std::format("Next scan {}: {} candidates on {} pages, {} bytes", m_scans, count(), pageCount(), memoryUsage()));
+        return true;
+    }
+
+    void ValueScanner::forEach(const std::function<bool(uintptr_t address, const uint8_t* value)>& fn) const
+    {
+        if (isStored() && m_scans > 0) {
+            ScanStoreReader reader(m_storePath);
+            ResultPage page;
+            bool more = true;
+            while (more && reader.next(page)) more = forEachIn(page, fn);
+            return;
+        }
+
+        for (const ResultPage& page : m_pages) {
+            if (!forEachIn(page, fn)) return;
+        }
+    }
+
+    bool ValueScanner::forEachIn(const ResultPage& page, const std::function<bool(uintptr_t address, const uint8_t* value)>& fn) const
+    {
+        switch (page.kind) {
+        case ResultPage::Kind::Full:
+            for (size_t slot = 0; slot < slots(); slot++) {
+                if (!fn(page.address + slot * m_alignment, page.values.data() + slot * m_alignment)) return false;
+            }
+            break;
+        case ResultPage::Kind::Bitmap:
+            for (size_t word = 0; word < page.bitmap.size(); word++) {
+                for (uint64_t mask = page.bitmap.at(word); mask; mask &= mask - 1) {
+                    size_t offset = (word * 64 + std::countr_zero(mask)) * m_alignment;
+                    if (!fn(page.address + offset, page.values.data() + offset)) return false;
+                }
+            }
+            break;
+        case ResultPage::Kind::Sparse:
+            for (size_t i = 0; i < page.offsets.size(); i++) {
+                if (!fn(page.address + page.offsets.at(i), page.values.data() + i * m_size)) return false;
+            }
+            break;
+        }
+        return true;
+    }
+
+    std::vector<uintptr_t> ValueScanner::addresses(size_t limit) const
+    {
+        std::vector<uintptr_t> found;
+        if (limit == 0) return found;
+        forEach([&](uintptr_t address, const uint8_t*) {
+            found.push_back(address);
+            return found.size() < limit;
+        });
+        return found;
+    }
+} // namespace fatigue
@@ -0,0 +1,232 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <vector>
+#include "MapIndex.hpp"
+#include "Region.hpp"
+#include "utils.hpp"
+
+namespace fatigue {
+    /** Type of the values a ValueScanner looks for */
+    enum class ValueType : uint8_t {
+        Int8, Int16, Int32, Int64,
+        UInt8, UInt16, UInt32, UInt64,
+        Float, Double
+    };
+
+    /** Size of a value type in bytes */
+    size_t valueSize(ValueType type);
+    /** Name of a value type, e.g. "int32" */
+    std::string_view valueTypeName(ValueType type);
+    /** Parse a value type name (int8..int64, uint8..uint64, float, double) */
+    bool parseValueType(std::string_view name, ValueType& type);
+
+    /**
+     * How candidates are picked
+     * First scans: Exact, Range, Unknown. Next scans: anything but Unknown, comparing with the value
+     * each candidate had at the previous scan (Exact is "equal to" a given value).
+     */
+    enum class ScanMode : uint8_t {
+        Exact,
+        /** Between two values, inclusive */
+        Range,
+        /** Every slot, to narrow down with next scans */
+        Unknown,
+        Changed,
+        Unchanged,
+        Increased,
+        Decreased
+    };
+
+    /** Parse a scan mode name, e.g. "exact" or "increased" */
+    bool parseScanMode(std::string_view name, ScanMode& mode);
+
+    /** A value of any ValueType, as its raw bytes */
+    struct ScanValue {
+        uint8_t bytes[8]{};
+
+        template <typename T>
+        static inline ScanValue of(T value)
+        {
+            static_assert(sizeof(T) <= 8);
+            ScanValue result;
+            memcpy(result.bytes, &value, sizeof(T));
+            return result;
+        }
+
+        template <typename T>
+        inline T as() const
+        {
+            T value;
+            memcpy(&value, bytes, sizeof(T));
+            return value;
+        }
+
+        /** Parse a number as a value type (@see string::parseNumber) */
+        static bool parse(ValueType type, std::string_view text, ScanValue& value);
+        /** Format a value of a type as a string */
+        static std::string format(ValueType type, const void* data);
+    };
+
+    /**
+     * Candidates of one page of process memory
+     * Dense pages keep one bit per slot and a copy of the whole page (the values at the last scan),
+     * sparse pages keep the sorted offsets of their candidates and just their values. A page where
+     * every slot is a candidate (unknown initial value) needs no bitmap at all.
+     */
+    struct ResultPage {
+        enum class Kind : uint8_t {
+            /** Every slot is a candidate, values holds the page */
+            Full,
+            /** bitmap marks the candidates, values holds the page */
+            Bitmap,
+            /** offsets lists the candidates, values holds one value per offset */
+            Sparse
+        };
+
+        /** Absolute address of the page */
+        uintptr_t address{0};
+        Kind kind{Kind::Full};
+        uint32_t count{0};
+        std::vector<uint64_t> bitmap{};
+        std::vector<uint16_t> offsets{};
+        std::vector<uint8_t> values{};
+
+        /** Bytes used by the page, including its values */
+        inline size_t memoryUsage() const
+        {
+            return sizeof(ResultPage) + bitmap.capacity() * sizeof(uint64_t) + offsets.capacity() * sizeof(uint16_t) + values.capacity();
+        }
+    };
+
+    /**
+     * @brief Find the address of a value by scanning for it, then narrowing down with next scans
+     * The first scan reads every readable and writable map of the process (or the regions given
+     * with setRegions()), in chunks and skipping unreadable pages. Results are kept per page of
+     * pageBytes (@see ResultPage), so a scan for an unknown initial value costs a copy of the memory
+     * scanned, and a handful of matches costs a few bytes per page.
+     * Next scans read the candidate pages back in batches with as few syscalls as possible, and
+     * compare a whole page at a time with SIMD kernels (AVX2 or SSE2, @see search::setEngine) when
+     * values are aligned to their size (the default).
+     * With a store (@see useStore), results live in a file instead: scans write the pages one by one,
+     * and next scans stream the previous file batch by batch into a new one, so memory use stays at
+     * one batch whatever the number of candidates. The file outlives the scanner, a later run can
+     * pick up the results of an earlier one.
+     */
+    class ValueScanner {
+    public:
+        /** Granularity of the results, independent of the system page size */
+        static constexpr size_t pageBytes = 4096;
+        /** Pages read per batch by next scans */
+        static constexpr size_t batchPages = 256;
+
+    protected:
+        pid_t m_pid{0};
+        ValueType m_type{ValueType::Int32};
+        size_t m_size{4};
+        size_t m_alignment{4};
+        uint8_t m_perms{proc::PERM_READ | proc::PERM_WRITE};
+        std::vector<Region> m_regions{};
+
+        std::vector<ResultPage> m_pages{};
+        size_t m_scans{0};
+
+        /** Results file (@see ScanStoreWriter), empty to keep results in memory */
+        std::string m_storePath{};
+        size_t m_storedPages{0};
+        size_t m_storedCount{0};
+
+        /** Number of value slots in a page */
+        inline size_t slots() const { return (pageBytes - m_size) / m_alignment + 1; }
+
+        /** Regions of the first scan, the process maps with m_perms unless set */
+        std::vector<Region> scanRegions() const;
+        /** Clear the bits of the slots of a page that fail a comparison */
+        void filter(ScanMode mode, const uint8_t* current, const uint8_t* previous, const ScanValue& a, const ScanValue& b, std::vector<uint64_t>& bits) const;
+        /** Store the candidates of a page (bits over data), choosing the smallest layout */
+        bool store(ResultPage& page, std::vector<uint64_t>& bits, const uint8_t* data) const;
+        /** Compare the candidates of a page with its current contents, returns false if none are left */
+        bool update(ResultPage& page, ScanMode mode, const uint8_t* current, const ScanValue& a, const ScanValue& b) const;
+        /** Read a batch of pages and update them, moving the pages with candidates left to the front */
+        size_t updateBatch(std::span<ResultPage> pages, ScanMode mode, const ScanValue& a, const ScanValue& b, std::vector<uint8_t>& buffer) const;
+        bool forEachIn(const ResultPage& page, const std::function<bool(uintptr_t address, const uint8_t* value)>& fn) const;
+
+    public:
+        /**
+         * @param pid Process to scan
+         * @param type Type of the values
+         * @param alignment Scan only addresses that are a multiple of this, 0 for the value size
+         */
+        ValueScanner(pid_t pid, ValueType type, size_t alignment = 0);
+        ~ValueScanner() = default;
+
+        inline pid_t pid() const { return m_pid; }
+        inline ValueType type() const { return m_type; }
+        inline size_t valueSize() const { return m_size; }
+        inline size_t alignment() const { return m_alignment; }
+        /** Number of scans done since the first scan, 0 before it */
+        inline size_t scans() const { return m_scans; }
+        /** Pages of results kept in memory, empty with a store */
+        inline const std::vector<ResultPage>& pages() const { return m_pages; }
+        /** Check if results are kept in a file */
+        inline bool isStored() const { return !m_storePath.empty(); }
+        inline const std::string& storePath() const { return m_storePath; }
+
+        /**
+         * Get a results file for a process in $XDG_RUNTIME_DIR/memoryfatigue, or next to the signature
+         * caches (@see SignatureCache::defaultDirectory), or in the temporary directory if neither is set
+         */
+        static std::string defaultStorePath(pid_t pid);
+        /**
+         * @brief Keep results in a file, picking up the results already there
+         * Results already in memory are dropped. The file is only used if it holds results for this
+         * very process (pid and start time), type and alignment; otherwise the next first scan
+         * replaces it.
+         * @return true if the file holds results to continue with
+         */
+        bool useStore(const std::string& path);
+
+        /** Scan these regions instead of the process maps (regions are trimmed to whole pages) */
+        inline void setRegions(const std::vector<Region>& regions) { m_regions = regions; }
+        /** Scan maps with these proc::PERM_* bits (default readable and writable) */
+        inline void setPerms(uint8_t perms) { m_perms = perms; }
+
+        /** Number of candidates */
+        size_t count() const;
+        /** Number of pages with candidates */
+        size_t pageCount() const;
+        /** Bytes used by the results in memory */
+        size_t memoryUsage() const;
+
+        /**
+         * @brief Scan all memory for the first time, replacing any previous results
+         * With a store, the previous results are only replaced once the new ones are complete.
+         * @param mode Exact (a), Range (a to b), or Unknown
+         * @return false if the mode cannot start a scan
+         */
+        bool firstScan(ScanMode mode, const ScanValue& a = {}, const ScanValue& b = {});
+        /**
+         * @brief Keep the candidates that pass a comparison with their current value
+         * Candidates on pages that can no longer be read are dropped.
+         * @param mode Any mode but Unknown; Exact and Range compare with a (and b)
+         * @return false if there was no first scan or the mode cannot be used
+         */
+        bool nextScan(ScanMode mode, const ScanValue& a = {}, const ScanValue& b = {});
+        /** Drop all results (and delete the store file) */
+        void reset();
+
+        /**
+         * Call a function for every candidate in address order, with its value at the last scan
+         * Return false from the function to stop.
+         */
+        void forEach(const std::function<bool(uintptr_t address, const uint8_t* value)>& fn) const;
+        /** Get the addresses of up to limit candidates */
+        std::vector<uintptr_t> addresses(size_t limit = SIZE_MAX) const;
+    };
+} // namespace fatigue
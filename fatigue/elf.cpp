@@ -4,7 +4,7 @@ using namespace fatigue::mem::sys;
 
 namespace fatigue::elf {
     bool isValidElf(pid_t pid, uintptr_t address) {
-        std::byte header[4];
+        std::byte header[4]{};
         sys::read(pid, address, &header, sizeof(header));
 
         std::string magic = std::string((char*)&header[0], 4);
@@ -3,8 +3,22 @@
 #include "log.hpp"
 #include "utils.hpp"
 #include "mem.hpp"
+#include "ProcessHandle.hpp"
+#include "RegionSnapshot.hpp"
 #include "Region.hpp"
+#include "ExecMonitor.hpp"
+#include "ProcessScanner.hpp"
 #include "proc.hpp"
+#include "MapTable.hpp"
+#include "MapIndex.hpp"
+#include "MapWatcher.hpp"
 #include "pe.hpp"
 #include "elf.hpp"
+#include "scan.hpp"
 #include "Patch.hpp"
+#include "PatchSet.hpp"
+#include "SignatureCache.hpp"
+#include "Manifest.hpp"
+#include "PointerChain.hpp"
+#include "ValueScanner.hpp"
+#include "ScanStore.hpp"
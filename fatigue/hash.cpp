@@ -0,0 +1,122 @@
+#include <bit>
+#include <cstring>
+#include "utils.hpp"
+
+namespace fatigue {
+    namespace hash {
+        namespace {
+            const uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+            const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+            const uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+            const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+            const uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+
+            inline uint64_t read64(const uint8_t* data)
+            {
+                uint64_t value;
+                memcpy(&value, data, sizeof(value));
+                return value;
+            }
+
+            inline uint32_t read32(const uint8_t* data)
+            {
+                uint32_t value;
+                memcpy(&value, data, sizeof(value));
+                return value;
+            }
+
+            inline uint64_t round(uint64_t lane, uint64_t input)
+            {
+                lane += input * PRIME2;
+                lane = std::rotl(lane, 31);
+                return lane * PRIME1;
+            }
+
+            inline uint64_t merge(uint64_t hash, uint64_t lane)
+            {
+                hash ^= round(0, lane);
+                return hash * PRIME1 + PRIME4;
+            }
+
+            /** Consume whole 32 byte stripes, returns the number of bytes consumed */
+            inline size_t stripes(uint64_t (&lanes)[4], const uint8_t* data, size_t size)
+            {
+                uint64_t a = lanes[0], b = lanes[1], c = lanes[2], d = lanes[3];
+                size_t offset = 0;
+                for (; offset + 32 <= size; offset += 32) {
+                    a = round(a, read64(data + offset));
+                    b = round(b, read64(data + offset + 8));
+                    c = round(c, read64(data + offset + 16));
+                    d = round(d, read64(data + offset + 24));
+                }
+                lanes[0] = a; lanes[1] = b; lanes[2] = c; lanes[3] = d;
+                return offset;
+            }
+        } // namespace
+
+        Hasher::Hasher(uint64_t seed)
+            : m_lanes{seed + PRIME1 + PRIME2, seed + PRIME2, seed, seed - PRIME1}, m_seed(seed)
+        {
+        }
+
+        void Hasher::update(const void* data, size_t size)
+        {
+            if (!data || size == 0) return;
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            m_total += size;
+
+            // Top up a partial stripe left from the previous update first
+            if (m_buffered > 0) {
+                size_t fill = std::min(size, sizeof(m_buffer) - m_buffered);
+                memcpy(m_buffer + m_buffered, bytes, fill);
+                m_buffered += fill;
+                bytes += fill;
+                size -= fill;
+
+                if (m_buffered < sizeof(m_buffer)) return;
+                stripes(m_lanes, m_buffer, sizeof(m_buffer));
+                m_buffered = 0;
+            }
+
+            size_t consumed = stripes(m_lanes, bytes, size);
+            m_buffered = size - consumed;
+            memcpy(m_buffer, bytes + consumed, m_buffered);
+        }
+
+        uint64_t Hasher::digest() const
+        {
+            uint64_t hash;
+            if (m_total >= 32) {
+                hash = std::rotl(m_lanes[0], 1) + std::rotl(m_lanes[1], 7) + std::rotl(m_lanes[2], 12) + std::rotl(m_lanes[3], 18);
+                for (uint64_t lane : m_lanes) hash = merge(hash, lane);
+            } else {
+                hash = m_seed + PRIME5;
+            }
+            hash += m_total;
+
+            // Tail of less than one stripe
+            size_t offset = 0;
+            for (; offset + 8 <= m_buffered; offset += 8) {
+                hash ^= round(0, read64(m_buffer + offset));
+                hash = std::rotl(hash, 27) * PRIME1 + PRIME4;
+            }
+            if (offset + 4 <= m_buffered) {
+                hash ^= static_cast<uint64_t>(read32(m_buffer + offset)) * PRIME1;
+                hash = std::rotl(hash, 23) * PRIME2 + PRIME3;
+                offset += 4;
+            }
+            for (; offset < m_buffered; offset++) {
+                hash ^= m_buffer[offset] * PRIME5;
+                hash = std::rotl(hash, 11) * PRIME1;
+            }
+
+            // Avalanche
+            hash ^= hash >> 33;
+            hash *= PRIME2;
+            hash ^= hash >> 29;
+            hash *= PRIME3;
+            hash ^= hash >> 32;
+            return hash;
+        }
+    } // namespace hash
+} // namespace fatigue
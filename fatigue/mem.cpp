@@ -1,11 +1,14 @@
+#include <algorithm>
+#include <climits>
 #include <fcntl.h>
-#include <filesystem>
 #include <string.h>
 #include <sys/ptrace.h>
 #include <sys/uio.h>
 #include <unistd.h>
+#include <vector>
 #include "log.hpp"
 #include "mem.hpp"
+#include "ProcessHandle.hpp"
 #include "proc.hpp"
 
 namespace fatigue::mem {
@@ -15,6 +18,83 @@ namespace fatigue::mem {
     void setAccessMethod(AccessMethod method) { s_accessMethod = method; }
     AccessMethod getAccessMethod() { return s_accessMethod; }
 
+    size_t pageSize()
+    {
+        static const size_t s_pageSize = [] {
+            long size = sysconf(_SC_PAGESIZE);
+            return size > 0 ? static_cast<size_t>(size) : 4096;
+        }();
+        return s_pageSize;
+    }
+
+    // PageBitmap
+
+    PageBitmap::PageBitmap(uintptr_t address, size_t size) : address(address), size(size)
+    {
+        if (size == 0) return;
+        uintptr_t first = address / pageSize();
+        uintptr_t last = (address + size - 1) / pageSize();
+        unreadable.assign(last - first + 1, false);
+    }
+
+    void PageBitmap::mark(size_t offset, size_t length)
+    {
+        if (length == 0 || offset >= size) return;
+        length = std::min(length, size - offset);
+
+        uintptr_t base = address / pageSize();
+        uintptr_t first = (address + offset) / pageSize() - base;
+        uintptr_t last = (address + offset + length - 1) / pageSize() - base;
+        for (uintptr_t page = first; page <= last; page++) unreadable.at(page) = true;
+    }
+
+    bool PageBitmap::any() const
+    {
+        return std::find(unreadable.begin(), unreadable.end(), true) != unreadable.end();
+    }
+
+    size_t PageBitmap::unreadableBytes() const
+    {
+        size_t total = 0;
+        for (auto& [offset, length] : readable()) total += length;
+        return size - total;
+    }
+
+    bool PageBitmap::isReadable(size_t offset, size_t length) const
+    {
+        if (length == 0) return true;
+        if (offset + length > size) return false;
+
+        uintptr_t base = address / pageSize();
+        uintptr_t first = (address + offset) / pageSize() - base;
+        uintptr_t last = (address + offset + length - 1) / pageSize() - base;
+        for (uintptr_t page = first; page <= last; page++) {
+            if (unreadable.at(page)) return false;
+        }
+        return true;
+    }
+
+    std::vector<std::pair<size_t, size_t>> PageBitmap::readable() const
+    {
+        std::vector<std::pair<size_t, size_t>> runs;
+        if (size == 0) return runs;
+
+        // Walk page by page, merging readable pages into runs (clipped to the range)
+        uintptr_t pageStart = address - address % pageSize();
+        for (size_t page = 0; page < unreadable.size(); page++, pageStart += pageSize()) {
+            if (unreadable.at(page)) continue;
+
+            size_t from = pageStart > address ? pageStart - address : 0;
+            size_t to = std::min(pageStart + pageSize() - address, size);
+            if (!runs.empty() && runs.back().first + runs.back().second == from) {
+                runs.back().second = to - runs.back().first;
+            } else {
+                runs.push_back({from, to - from});
+            }
+        }
+        return runs;
+    }
+
     namespace sys {
         ssize_t read(pid_t pid, uintptr_t address, void* buffer, size_t size)
         {
@@ -27,6 +107,61 @@ namespace fatigue::mem {
             return bytesRead;
         }
 
+        size_t readv(pid_t pid, std::span<ReadRequest> requests)
+        {
+            for (auto& request : requests) {
+                request.bytesRead = 0;
+                request.error = 0;
+            }
+            if (pid <= 0 || requests.empty()) return 0;
+
+            size_t complete = 0;
+            std::vector<struct iovec> local(std::min<size_t>(requests.size(), IOV_MAX));
+            std::vector<struct iovec> remote(local.size());
+
+            for (size_t i = 0; i < requests.size();) {
+                size_t count = std::min(requests.size() - i, local.size());
+                for (size_t j = 0; j < count; j++) {
+                    local[j] = { .iov_base = requests[i + j].buffer, .iov_len = requests[i + j].size };
+                    remote[j] = { .iov_base = reinterpret_cast<void*>(requests[i + j].address), .iov_len = requests[i + j].size };
+                }
+
+                errno = 0;
+                ssize_t bytesRead = process_vm_readv(pid, local.data(), count, remote.data(), count, 0);
+
+                if (bytesRead < 0) {
+                    // Nothing was read, so the first entry failed; without a process there is no point going on
+                    int error = errno;
+                    if (error == ESRCH) {
+                        for (; i < requests.size(); i++) requests[i].error = error;
+                        break;
+                    }
+                    requests[i++].error = error;
+                    continue;
+                }
+
+                // Transfers stop at the first entry that fails, so hand out the bytes in order
+                size_t remaining = bytesRead;
+                size_t j = i;
+                for (; j < i + count && remaining >= requests[j].size; j++) {
+                    requests[j].bytesRead = requests[j].size;
+                    remaining -= requests[j].size;
+                    complete++;
+                }
+
+                // Record the short entry (if any) and resume the batch after it
+                if (j < i + count) {
+                    requests[j].bytesRead = remaining;
+                    requests[j].error = EFAULT;
+                    j++;
+                }
+
+                i = j;
+            }
+
+            return complete;
+        }
+
         ssize_t write(pid_t pid, uintptr_t address, const void* buffer, size_t size)
         {
             if (pid <= 0 || address <= 0 || size <= 0) return 0;
@@ -44,79 +179,130 @@ namespace fatigue::mem {
         {
             if (pid <= 0 || address <= 0 || size <= 0) return 0;
 
-            std::filesystem::path path = std::format("/proc/{}/mem", pid);
-            auto fd = open(path.c_str(), O_RDONLY);
-
-            ssize_t bytesRead = pread64(fd, buffer, size, address);
+            auto handle = ProcessHandle::get(pid);
+            if (!handle) return -1;
 
-            close(fd);
-
-            return bytesRead;
+            // No retry on a fresh handle: if the process is gone, its pid may now be another process
+            return handle->read(address, buffer, size);
         }
 
         ssize_t write(pid_t pid, uintptr_t address, const void* buffer, size_t size)
         {
             if (pid <= 0 || address <= 0 || size <= 0) return 0;
 
-            std::filesystem::path path = std::format("/proc/{}/mem", pid);
-            auto fd = open(path.c_str(), O_RDWR);
-
-            ssize_t bytesWritten = pwrite64(fd, buffer, size, address);
-
-            close(fd);
+            auto handle = ProcessHandle::get(pid);
+            if (!handle) return -1;
 
-            return bytesWritten;
+            return handle->write(address, buffer, size);
         }
     } // namespace io
 
     namespace trace {
+        thread_local Stats s_lastStats{};
+
+        Stats lastStats() { return s_lastStats; }
+
+        namespace {
+            constexpr size_t wordSize = sizeof(long);
+
+            /** Peek one aligned word, counting the syscall */
+            bool peek(pid_t pid, uintptr_t address, long& data)
+            {
+                errno = 0;
+                s_lastStats.syscalls++;
+                data = ptrace(PTRACE_PEEKDATA, pid, address, 0);
+                return errno == 0;
+            }
+
+            /** Poke one aligned word, counting the syscall */
+            bool poke(pid_t pid, uintptr_t address, long data)
+            {
+                errno = 0;
+                s_lastStats.syscalls++;
+                return ptrace(PTRACE_POKEDATA, pid, address, data) == 0;
+            }
+
+            /** Try a bulk transfer through /proc/[pid]/mem, returns false to fall back to words */
+            template <typename Fn>
+            bool bulk(pid_t pid, size_t size, Fn transfer)
+            {
+                if (size < bulkThreshold) return false;
+
+                auto handle = ProcessHandle::get(pid);
+                if (!handle) return false;
+
+                s_lastStats.syscalls++;
+                if (transfer(*handle) != static_cast<ssize_t>(size)) return false;
+
+                s_lastStats.bulk = true;
+                return true;
+            }
+        } // namespace
+
         size_t read(pid_t pid, uintptr_t address, void* buffer, size_t size)
         {
+            s_lastStats = {};
             if (pid <= 0 || address <= 0 || size <= 0) return 0;
 
-            size_t bytesRead = 0;
+            if (bulk(pid, size, [&](const ProcessHandle& handle) { return handle.read(address, buffer, size); })) {
+                return size;
+            }
 
-            while (bytesRead < size)
-            {
-                errno = 0;
-                long data = ptrace(PTRACE_PEEKDATA, pid, address + bytesRead, 0);
+            uint8_t* out = static_cast<uint8_t*>(buffer);
+            size_t bytesRead = 0;
 
-                if (errno != 0)
-                {
-                    logError(std::format("mem::ptrace::read: failed to read from {:#x}: {}", address + bytesRead, strerror(errno)));
+            // Walk aligned words, copying only the part of each word that is inside the range
+            for (uintptr_t word = address & ~(wordSize - 1); bytesRead < size; word += wordSize) {
+                long data = 0;
+                if (!peek(pid, word, data)) {
+                    logError(std::format("mem::ptrace::read: failed to read from {:#x}: {}", word, strerror(errno)));
                     return bytesRead;
                 }
 
-                memcpy(static_cast<uint8_t*>(buffer) + bytesRead, &data, sizeof(data));
-                bytesRead += sizeof(data);
+                size_t skip = word < address ? address - word : 0;
+                size_t count = std::min(wordSize - skip, size - bytesRead);
+                memcpy(out + bytesRead, reinterpret_cast<uint8_t*>(&data) + skip, count);
+                bytesRead += count;
             }
 
+            logDebug(std::format("mem::ptrace::read: {} bytes in {} syscalls", bytesRead, s_lastStats.syscalls));
             return bytesRead;
         }
 
         size_t write(pid_t pid, uintptr_t address, const void* buffer, size_t size)
         {
+            s_lastStats = {};
             if (pid <= 0 || address <= 0 || size <= 0) return 0;
 
+            if (bulk(pid, size, [&](const ProcessHandle& handle) { return handle.write(address, buffer, size); })) {
+                return size;
+            }
+
+            const uint8_t* in = static_cast<const uint8_t*>(buffer);
             size_t bytesWritten = 0;
 
-            while (bytesWritten < size)
-            {
+            for (uintptr_t word = address & ~(wordSize - 1); bytesWritten < size; word += wordSize) {
+                size_t skip = word < address ? address - word : 0;
+                size_t count = std::min(wordSize - skip, size - bytesWritten);
+
+                // Partial words (head or tail) keep the bytes outside the range
                 long data = 0;
-                memcpy(&data, static_cast<const uint8_t*>(buffer) + bytesWritten, sizeof(data));
+                if (count < wordSize && !peek(pid, word, data)) {
+                    logError(std::format("mem::ptrace::write: failed to read {:#x} before write: {}", word, strerror(errno)));
+                    return bytesWritten;
+                }
 
-                errno = 0;
-                ptrace(PTRACE_POKEDATA, pid, address + bytesWritten, data);
+                memcpy(reinterpret_cast<uint8_t*>(&data) + skip, in + bytesWritten, count);
 
-                if (errno != 0)
-                {
-                    logError(std::format("mem::ptrace::write: failed to write to {:#x}: {}", address + bytesWritten, errno));
+                if (!poke(pid, word, data)) {
+                    logError(std::format("mem::ptrace::write: failed to write to {:#x}: {}", word, strerror(errno)));
                     return bytesWritten;
                 }
 
-                bytesWritten += sizeof(data);
+                bytesWritten += count;
             }
 
+            logDebug(std::format("mem::ptrace::write: {} bytes in {} syscalls", bytesWritten, s_lastStats.syscalls));
             return bytesWritten;
         }
     } // namespace ptrace
@@ -1,7 +1,10 @@
 #pragma once
 
 #include <cstdint>
+#include <span>
 #include <sys/types.h>
+#include <utility>
+#include <vector>
 
 /**
  * Dead simple memory reading and writing for Linux processes
@@ -12,12 +15,63 @@ namespace fatigue::mem {
     enum class AccessMethod {
         SYS,
         IO,
-        PTRACE
+        PTRACE,
+        URING
     };
 
     void setAccessMethod(AccessMethod method);
     AccessMethod getAccessMethod();
 
+    /**
+     * One entry of a scatter-gather read
+     * Results are reported per entry, so one unreadable address does not fail the whole batch
+     */
+    struct ReadRequest {
+        /** Address to read from (absolute for mem functions, an offset for Region::readMany) */
+        uintptr_t address{0};
+        /** Local buffer of at least size bytes */
+        void* buffer{nullptr};
+        size_t size{0};
+
+        /** Number of bytes actually read */
+        size_t bytesRead{0};
+        /** errno of the failed read, if bytesRead < size (0 if unknown) */
+        int error{0};
+
+        inline bool complete() const { return bytesRead == size; }
+    };
+
+    /** Size of a memory page (the granularity of unreadable holes) */
+    size_t pageSize();
+
+    /**
+     * Pages of a range that could not be read
+     * Filled by sparse reads (see Region::readSparse), which zero unreadable pages instead of failing.
+     * Pages are aligned to absolute addresses, so the first and last may extend past the range.
+     */
+    struct PageBitmap {
+        /** Absolute address of the start of the range */
+        uintptr_t address{0};
+        /** Size of the range in bytes */
+        size_t size{0};
+        /** One flag per page touched by the range, true if the page could not be read */
+        std::vector<bool> unreadable{};
+
+        PageBitmap() = default;
+        PageBitmap(uintptr_t address, size_t size);
+
+        /** Flag the pages covering [offset, offset + length) of the range as unreadable */
+        void mark(size_t offset, size_t length);
+        /** Check if any page could not be read */
+        bool any() const;
+        /** Number of bytes of the range that could not be read */
+        size_t unreadableBytes() const;
+        /** Check if [offset, offset + length) of the range was read */
+        bool isReadable(size_t offset, size_t length) const;
+        /** Readable stretches of the range, as (offset, length) pairs in ascending order */
+        std::vector<std::pair<size_t, size_t>> readable() const;
+    };
+
     /**
      * Read and write process memory using syscalls
      * Fast, but will not work to patch memory of another process (see io::write or trace::write)
@@ -28,6 +82,14 @@ namespace fatigue::mem {
         /** Write process memory using process_vm_writev */
         ssize_t write(pid_t pid, uintptr_t address, const void* buffer, size_t size);
 
+        /**
+         * Read many process memory ranges using as few process_vm_readv calls as possible
+         * Up to IOV_MAX entries are sent per call; an entry that cannot be read is recorded and
+         * the batch resumes after it.
+         * @return Number of requests that were read completely
+         */
+        size_t readv(pid_t pid, std::span<ReadRequest> requests);
+
         /** Read process memory using process_vm_readv into known type */
         template <typename T>
         ssize_t read(pid_t pid, uintptr_t address, T* value)
@@ -44,6 +106,7 @@ namespace fatigue::mem {
 
     /**
      * Read and write process memory using /proc/[pid]/mem file IO
+     * The mem file is opened once per process and kept open (see ProcessHandle)
      * Important, if you intend to write to memory of another process, you will need to attach first,
      * use io::write or trace::write (sys::write will not work!), and then detach.
      */
@@ -69,11 +132,28 @@ namespace fatigue::mem {
 
     /**
      * Read and write process memory using ptrace
-     * Slow, but should work everywhere PTRACE is available
+     * Small accesses are done a word at a time with PEEKDATA/POKEDATA on aligned words (unaligned
+     * heads and tails are read-modify-written, so bytes around the range are never touched).
+     * Transfers of at least bulkThreshold bytes go through /proc/[pid]/mem instead, which works on
+     * the attached tracee with a single syscall, and fall back to words if that fails.
      * Important, if you intend to write to memory of another process, you will need to attach first,
      * use io::write or trace::write (sys::write will not work!), and then detach.
      */
     namespace trace {
+        /** Transfers of at least this many bytes use /proc/[pid]/mem */
+        const size_t bulkThreshold = 64;
+
+        /** What the last read or write on this thread cost */
+        struct Stats {
+            /** Number of syscalls made (ptrace, pread, pwrite) */
+            size_t syscalls{0};
+            /** True if the transfer went through /proc/[pid]/mem */
+            bool bulk{false};
+        };
+
+        /** Get the stats of the last trace::read or trace::write on the calling thread */
+        Stats lastStats();
+
         /** Read process memory using ptrace */
         size_t read(pid_t pid, uintptr_t address, void* buffer, size_t size);
         /** Write process memory using ptrace */
@@ -92,4 +172,43 @@ namespace fatigue::mem {
             return write(pid, address, value, sizeof(T));
         }
     } // namespace ptrace
+
+    /**
+     * Read and write process memory using io_uring against the shared /proc/[pid]/mem descriptor
+     * Batches of reads (including the scattered reads of Region::readMany) are submitted together
+     * and completed with a single io_uring_enter, and large reads are split into pieces that are in
+     * flight at once. Each thread gets its own ring.
+     * If io_uring is not available (old kernel, disabled by sysctl or seccomp), reads and writes fall
+     * back to io:: and batches to sys::readv, transparently.
+     */
+    namespace uring {
+        /** Check if io_uring can be used (the first call tries to set up a ring) */
+        bool isAvailable();
+
+        /** Read process memory, split into concurrent pieces if large */
+        ssize_t read(pid_t pid, uintptr_t address, void* buffer, size_t size);
+        /** Write process memory, split into concurrent pieces if large */
+        ssize_t write(pid_t pid, uintptr_t address, const void* buffer, size_t size);
+
+        /**
+         * Read many process memory ranges, one IORING_OP_READ each, submitted together
+         * Requests complete independently, so failed ones cost no extra syscall (sys::readv resubmits after each)
+         * A request of 4 GiB or more is read short (one SQE carries a 32-bit length).
+         * @return Number of requests that were read completely
+         */
+        size_t readv(pid_t pid, std::span<ReadRequest> requests);
+
+        /** Read process memory into known type */
+        template <typename T>
+        ssize_t read(pid_t pid, uintptr_t address, T* value)
+        {
+            return read(pid, address, value, sizeof(T));
+        }
+        /** Write process memory from known type */
+        template <typename T>
+        ssize_t write(pid_t pid, uintptr_t address, const T* value)
+        {
+            return write(pid, address, value, sizeof(T));
+        }
+    } // namespace uring
 }
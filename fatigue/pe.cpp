@@ -1,10 +1,13 @@
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
 #include "pe.hpp"
 
 using namespace fatigue::mem::sys;
 
 namespace fatigue::pe {
     bool isValidPE(pid_t pid, uintptr_t address) {
-        DosHeader dos;
+        DosHeader dos{0};
         sys::read(pid, address, &dos, sizeof(dos));
         return dos.magic == DOS_MAGIC;
     }
@@ -31,18 +34,68 @@ namespace fatigue::pe {
             return;
         }
 
-        // Read COFF optional header, and check PE32+ magic number
+        // Read COFF optional header with the data directories, and check PE32/PE32+ magic number
+        uint8_t optional[sizeof(CoffOptionalHeader64) + sizeof(DataDirectory) * DIRECTORY_COUNT]{};
         std::size_t optionalSize = std::min(
-            // Do not read more than the size of the optional header, but also no more than the size of the struct
+            // Do not read more than the size of the optional header, but also no more than the buffer
             static_cast<std::size_t>(m_coff.optionalHeaderSize),
-            sizeof(m_optional)
+            sizeof(optional)
         );
-        read(m_dos.coffHeaderOffset + sizeof(m_coff), &m_optional, sizeof(m_optional));
-        if (m_optional.magic != PE32_MAGIC && m_optional.magic != PE32PLUS_MAGIC) {
+        if (optionalSize >= sizeof(uint16_t)) {
+            read(m_dos.coffHeaderOffset + sizeof(m_coff), optional, optionalSize);
+        }
+
+        uint16_t magic = 0;
+        memcpy(&magic, optional, sizeof(magic));
+        std::size_t headerSize = magic == PE32PLUS_MAGIC ? sizeof(CoffOptionalHeader64) : sizeof(CoffOptionalHeader32);
+        if ((magic != PE32_MAGIC && magic != PE32PLUS_MAGIC) || optionalSize < headerSize) {
             logError(std::format("Invalid COFF optional header for {} {}", pid, name));
             return;
         }
 
+        if (magic == PE32PLUS_MAGIC) {
+            CoffOptionalHeader64 header;
+            memcpy(&header, optional, sizeof(header));
+            m_optional = {
+                header.magic, header.majorLinkerVersion, header.minorLinkerVersion,
+                header.sizeOfCode, header.sizeOfInitializedData, header.sizeOfUninitializedData,
+                header.addressOfEntryPoint, header.baseOfCode, 0, header.imageBase,
+                header.sectionAlignment, header.fileAlignment,
+                header.majorOperatingSystemVersion, header.minorOperatingSystemVersion,
+                header.majorImageVersion, header.minorImageVersion,
+                header.majorSubsystemVersion, header.minorSubsystemVersion,
+                header.win32VersionValue, header.sizeOfImage, header.sizeOfHeaders, header.checksum,
+                header.subsystem, header.dllCharacteristics,
+                header.sizeOfStackReserve, header.sizeOfStackCommit, header.sizeOfHeapReserve, header.sizeOfHeapCommit,
+                header.loaderFlags, header.rvaSizes
+            };
+        } else {
+            CoffOptionalHeader32 header;
+            memcpy(&header, optional, sizeof(header));
+            m_optional = {
+                header.magic, header.majorLinkerVersion, header.minorLinkerVersion,
+                header.sizeOfCode, header.sizeOfInitializedData, header.sizeOfUninitializedData,
+                header.addressOfEntryPoint, header.baseOfCode, header.baseOfData, header.imageBase,
+                header.sectionAlignment, header.fileAlignment,
+                header.majorOperatingSystemVersion, header.minorOperatingSystemVersion,
+                header.majorImageVersion, header.minorImageVersion,
+                header.majorSubsystemVersion, header.minorSubsystemVersion,
+                header.win32VersionValue, header.sizeOfImage, header.sizeOfHeaders, header.checksum,
+                header.subsystem, header.dllCharacteristics,
+                header.sizeOfStackReserve, header.sizeOfStackCommit, header.sizeOfHeapReserve, header.sizeOfHeapCommit,
+                header.loaderFlags, header.rvaSizes
+            };
+        }
+
+        // Data directories follow the header, there may be fewer than 16 (but never trust more)
+        std::size_t directoryCount = std::min<std::size_t>({
+            m_optional.rvaSizes,
+            DIRECTORY_COUNT,
+            (optionalSize - headerSize) / sizeof(DataDirectory)
+        });
+        m_directories = {};
+        memcpy(m_directories.data(), optional + headerSize, directoryCount * sizeof(DataDirectory));
+
         // Get section headers in a single read
         m_sections.resize(m_coff.sectionCount);
         read(
@@ -54,28 +107,396 @@ namespace fatigue::pe {
             logError(std::format("Invalid section headers for {} {}", pid, name));
             return;
         }
+
+        buildSectionTable();
     }
 
-    std::vector<Region> PeMap::getSections()
+    Region PeMap::image() const
     {
-        std::vector<Region> sections;
-        for (auto &it : m_sections) {
-            std::string name(it.name, sizeof(it.name));
-            name = string::trim(name);
-            sections.push_back(Region(pid, start + it.virtualAddress, start + it.virtualAddress + it.virtualSize, name));
+        Region image(pid, start, start + std::max<uint64_t>(m_optional.sizeOfImage, size()), name);
+        image.method = method;
+        return image;
+    }
+
+    void PeMap::buildSectionTable()
+    {
+        m_sectionTable.clear();
+        m_sectionRegions.clear();
+        m_sectionTable.reserve(m_sections.size());
+
+        for (const SectionHeader& header : m_sections) {
+            // Names are padded with NULs, but a full 8 character name has no terminator
+            std::string sectionName = string::trim(std::string_view(header.name, strnlen(header.name, sizeof(header.name))));
+            uint32_t size = header.virtualSize ? header.virtualSize : header.sizeOfRawData;
+
+            uint8_t perms = 0;
+            if (header.characteristics & SECTION_MEM_READ) perms |= proc::PERM_READ;
+            if (header.characteristics & SECTION_MEM_WRITE) perms |= proc::PERM_WRITE;
+            if (header.characteristics & SECTION_MEM_EXECUTE) perms |= proc::PERM_EXEC;
+            perms |= (header.characteristics & SECTION_MEM_SHARED) ? proc::PERM_SHARED : proc::PERM_PRIVATE;
+
+            Region region(pid, start + header.virtualAddress, start + header.virtualAddress + size, sectionName);
+            region.method = method;
+
+            m_sectionTable.push_back({
+                .name = sectionName,
+                .virtualAddress = header.virtualAddress,
+                .virtualSize = size,
+                .characteristics = header.characteristics,
+                .perms = perms,
+                .region = region
+            });
         }
-        return sections;
+
+        std::sort(m_sectionTable.begin(), m_sectionTable.end(), [](const Section& a, const Section& b) {
+            return a.virtualAddress < b.virtualAddress;
+        });
+
+        m_sectionRegions.reserve(m_sectionTable.size());
+        for (const Section& section : m_sectionTable) m_sectionRegions.push_back(section.region);
+    }
+
+    const Section* PeMap::rvaToSection(uint32_t rva) const
+    {
+        // Last section starting at or before the RVA
+        auto it = std::upper_bound(m_sectionTable.begin(), m_sectionTable.end(), rva, [](uint32_t value, const Section& section) {
+            return value < section.virtualAddress;
+        });
+        if (it == m_sectionTable.begin()) return nullptr;
+        --it;
+        return it->contains(rva) ? &*it : nullptr;
     }
 
-    Region PeMap::getSection(const std::string_view &name)
+    const Section* PeMap::findSection(std::string_view name) const
     {
-        for (auto &it : m_sections) {
-            std::string secName = string::trim(it.name);
-            // if secion name starts with a ., match with or without the dot
-            if (name == secName || (secName.starts_with(".") && name == secName.substr(1)))
-                return Region(pid, start + it.virtualAddress, start + it.virtualAddress + it.virtualSize, secName);
+        for (const Section& section : m_sectionTable) {
+            // if section name starts with a ., match with or without the dot
+            if (name == section.name || (section.name.starts_with(".") && name == std::string_view(section.name).substr(1)))
+                return &section;
         }
+        return nullptr;
+    }
+
+    Region PeMap::getSection(const std::string_view &name) const
+    {
+        const Section* section = findSection(name);
         // Return an invalid region if not found
-        return Region();
+        return section ? section->region : Region();
+    }
+
+    uint64_t PeMap::fingerprint(const std::vector<std::string>& sections) const
+    {
+        if (!isValid()) return 0;
+
+        hash::Hasher hasher;
+
+        // The headers are at most a few pages, read them in one go (never trust a huge size)
+        size_t headerSize = std::clamp<size_t>(m_optional.sizeOfHeaders, sizeof(m_dos), 64 * 1024);
+        std::vector<uint8_t> headers(headerSize);
+        headers.resize(readImage(0, headers.data(), headers.size()));
+        if (headers.empty()) return 0;
+        hasher.update(headers.data(), headers.size());
+
+        for (const std::string& sectionName : sections) {
+            const Section* section = findSection(sectionName);
+            if (!section) {
+                logWarning(std::format("Section '{}' not found in {}, not part of the fingerprint", sectionName, name));
+                continue;
+            }
+
+            // Mix in where each piece came from, so unreadable holes in different places hash differently
+            hasher.update(section->virtualAddress);
+            section->region.scan(0, [&](size_t offset, std::span<const uint8_t> data) {
+                hasher.update(offset);
+                hasher.update(data.data(), data.size());
+                return true;
+            });
+        }
+
+        uint64_t value = hasher.digest();
+        return value ? value : 1;
+    }
+
+    // Exports and imports
+
+    size_t PeMap::readImage(uint32_t rva, void* buffer, size_t size) const
+    {
+        if (size == 0) return 0;
+        mem::ReadRequest request{.address = rva, .buffer = buffer, .size = size};
+        image().readMany({&request, 1});
+        return request.bytesRead;
+    }
+
+    std::string PeMap::readImageString(uint32_t rva, size_t maxLength) const
+    {
+        // Strings in import and export tables are short, read a small piece at a time
+        std::string text;
+        char piece[64];
+        while (text.size() < maxLength) {
+            size_t bytesRead = readImage(rva + text.size(), piece, std::min(sizeof(piece), maxLength - text.size()));
+            if (bytesRead == 0) break;
+
+            size_t length = strnlen(piece, bytesRead);
+            text.append(piece, length);
+            if (length < bytesRead) break;
+        }
+        return text;
+    }
+
+    void PeMap::loadExports()
+    {
+        m_exportsLoaded = true;
+        m_exports.clear();
+        m_exportNames.clear();
+        m_exportOrdinals.clear();
+
+        DataDirectory directory = this->directory(DIRECTORY_EXPORT);
+        if (!isValid() || directory.virtualAddress == 0 || directory.size < sizeof(ExportDirectory)) return;
+
+        // The directory, its three arrays and the names are normally packed together, so one read
+        // fetches everything; anything pointing outside of it is read separately
+        std::vector<uint8_t> block(directory.size);
+        block.resize(readImage(directory.virtualAddress, block.data(), block.size()));
+        if (block.size() < sizeof(ExportDirectory)) {
+            logError(std::format("Failed to read export directory for {} {}", pid, name));
+            return;
+        }
+
+        ExportDirectory exports;
+        memcpy(&exports, block.data(), sizeof(exports));
+
+        auto inBlock = [&](uint32_t rva, size_t size) {
+            return rva >= directory.virtualAddress && rva - directory.virtualAddress + size <= block.size();
+        };
+        auto readArray = [&](uint32_t rva, auto& values, size_t count) {
+            using Value = typename std::remove_reference_t<decltype(values)>::value_type;
+            values.assign(count, Value{});
+            size_t size = count * sizeof(Value);
+            if (inBlock(rva, size)) {
+                memcpy(values.data(), block.data() + (rva - directory.virtualAddress), size);
+            } else {
+                values.resize(readImage(rva, values.data(), size) / sizeof(Value));
+            }
+        };
+        auto readString = [&](uint32_t rva) {
+            if (inBlock(rva, 1)) {
+                size_t offset = rva - directory.virtualAddress;
+                const char* text = reinterpret_cast<const char*>(block.data() + offset);
+                size_t length = strnlen(text, block.size() - offset);
+                if (offset + length < block.size()) return std::string(text, length);
+            }
+            return readImageString(rva);
+        };
+
+        // Guard against garbage counts, no real image exports more than 64k functions
+        const uint32_t maxCount = 0x10000;
+        std::vector<uint32_t> functions;
+        std::vector<uint32_t> names;
+        std::vector<uint16_t> ordinals;
+        readArray(exports.functionsRva, functions, std::min(exports.functionCount, maxCount));
+        readArray(exports.namesRva, names, std::min(exports.nameCount, maxCount));
+        readArray(exports.ordinalsRva, ordinals, std::min(exports.nameCount, maxCount));
+
+        m_exports.reserve(functions.size());
+        for (size_t i = 0; i < functions.size(); i++) {
+            uint32_t rva = functions.at(i);
+            if (rva == 0) continue; // Unused ordinal
+
+            Export entry{.ordinal = static_cast<uint32_t>(exports.ordinalBase + i), .rva = rva};
+            if (rva >= directory.virtualAddress && rva < directory.virtualAddress + directory.size) {
+                entry.forwarder = readString(rva);
+            } else {
+                entry.address = start + rva;
+            }
+            m_exportOrdinals.emplace(entry.ordinal, m_exports.size());
+            m_exports.push_back(std::move(entry));
+        }
+
+        // Names point into the function table by (unbiased) index
+        for (size_t i = 0; i < names.size() && i < ordinals.size(); i++) {
+            uint32_t ordinal = exports.ordinalBase + ordinals.at(i);
+            auto found = m_exportOrdinals.find(ordinal);
+            if (found == m_exportOrdinals.end()) continue;
+
+            Export& entry = m_exports.at(found->second);
+            std::string exportName = readString(names.at(i));
+            if (exportName.empty()) continue;
+            if (entry.name.empty()) entry.name = exportName;
+            m_exportNames.emplace(std::move(exportName), found->second);
+        }
+    }
+
+    const std::vector<Export>& PeMap::exports()
+    {
+        if (!m_exportsLoaded) loadExports();
+        return m_exports;
+    }
+
+    const Export* PeMap::findExport(std::string_view name)
+    {
+        if (!m_exportsLoaded) loadExports();
+        auto found = m_exportNames.find(name);
+        return found == m_exportNames.end() ? nullptr : &m_exports.at(found->second);
+    }
+
+    const Export* PeMap::findExport(uint32_t ordinal)
+    {
+        if (!m_exportsLoaded) loadExports();
+        auto found = m_exportOrdinals.find(ordinal);
+        return found == m_exportOrdinals.end() ? nullptr : &m_exports.at(found->second);
+    }
+
+    void PeMap::loadImports()
+    {
+        m_importsLoaded = true;
+        m_imports.clear();
+        m_importIndex.clear();
+
+        DataDirectory directory = this->directory(DIRECTORY_IMPORT);
+        if (!isValid() || directory.virtualAddress == 0) return;
+
+        // Descriptors end with an all zero entry, the directory size is not always set correctly
+        std::vector<ImportDescriptor> descriptors;
+        size_t count = std::max<size_t>(directory.size / sizeof(ImportDescriptor), 1);
+        const size_t maxCount = 4096;
+        while (count <= maxCount) {
+            descriptors.resize(count);
+            size_t bytesRead = readImage(directory.virtualAddress, descriptors.data(), count * sizeof(ImportDescriptor));
+            descriptors.resize(bytesRead / sizeof(ImportDescriptor));
+
+            auto terminator = std::find_if(descriptors.begin(), descriptors.end(), [](const ImportDescriptor& descriptor) {
+                return descriptor.name == 0 && descriptor.addressTableRva == 0;
+            });
+            if (terminator != descriptors.end() || descriptors.size() < count) {
+                descriptors.erase(terminator, descriptors.end());
+                break;
+            }
+            count *= 2;
+        }
+
+        const bool wide = m_optional.isPE32Plus();
+        const size_t thunkSize = wide ? sizeof(uint64_t) : sizeof(uint32_t);
+        const uint64_t ordinalFlag = wide ? 0x8000000000000000ULL : 0x80000000ULL;
+
+        // Read a whole thunk table up to its terminator, a chunk at a time
+        auto readThunks = [&](uint32_t rva, size_t limit) {
+            std::vector<uint64_t> thunks;
+            std::vector<uint8_t> chunk(256 * thunkSize);
+            while (thunks.size() < limit) {
+                size_t wanted = std::min(chunk.size(), (limit - thunks.size()) * thunkSize);
+                size_t bytesRead = readImage(rva + thunks.size() * thunkSize, chunk.data(), wanted);
+                for (size_t offset = 0; offset + thunkSize <= bytesRead; offset += thunkSize) {
+                    uint64_t thunk = 0;
+                    memcpy(&thunk, chunk.data() + offset, thunkSize);
+                    if (thunk == 0) return thunks;
+                    thunks.push_back(thunk);
+                }
+                if (bytesRead < wanted) break;
+            }
+            return thunks;
+        };
+
+        // Hint/name entries are scattered, collect them and read them all in one batch
+        struct Pending {
+            size_t import;
+            uint32_t rva;
+        };
+        std::vector<Pending> pending;
+        const size_t maxThunks = 0x10000;
+
+        for (const ImportDescriptor& descriptor : descriptors) {
+            std::string module = readImageString(descriptor.name, 256);
+            if (module.empty()) continue;
+
+            // The lookup table keeps the names once the loader has overwritten the address table
+            uint32_t lookupRva = descriptor.lookupTableRva ? descriptor.lookupTableRva : descriptor.addressTableRva;
+            std::vector<uint64_t> lookup = readThunks(lookupRva, maxThunks);
+
+            std::vector<uint64_t> addresses(lookup.size());
+            std::vector<uint8_t> table(lookup.size() * thunkSize);
+            size_t tableRead = readImage(descriptor.addressTableRva, table.data(), table.size());
+            for (size_t i = 0; i < lookup.size() && (i + 1) * thunkSize <= tableRead; i++) {
+                memcpy(&addresses.at(i), table.data() + i * thunkSize, thunkSize);
+            }
+
+            for (size_t i = 0; i < lookup.size(); i++) {
+                Import entry{
+                    .module = module,
+                    .slot = start + descriptor.addressTableRva + i * thunkSize,
+                    .address = static_cast<uintptr_t>(addresses.at(i))
+                };
+
+                uint64_t thunk = lookup.at(i);
+                if (thunk & ordinalFlag) {
+                    entry.ordinal = static_cast<uint16_t>(thunk & 0xFFFF);
+                } else if (thunk < m_optional.sizeOfImage) {
+                    pending.push_back({m_imports.size(), static_cast<uint32_t>(thunk)});
+                } else {
+                    // Bound already and no lookup table, the name is lost
+                    continue;
+                }
+                m_imports.push_back(std::move(entry));
+            }
+        }
+
+        const size_t nameSize = 256;
+        std::vector<char> names(pending.size() * (sizeof(uint16_t) + nameSize));
+        std::vector<mem::ReadRequest> requests(pending.size());
+        for (size_t i = 0; i < pending.size(); i++) {
+            requests.at(i) = {
+                .address = pending.at(i).rva,
+                .buffer = names.data() + i * (sizeof(uint16_t) + nameSize),
+                .size = sizeof(uint16_t) + nameSize
+            };
+        }
+        if (!requests.empty()) image().readMany(requests);
+
+        for (size_t i = 0; i < pending.size(); i++) {
+            Import& entry = m_imports.at(pending.at(i).import);
+            const mem::ReadRequest& request = requests.at(i);
+            const char* data = static_cast<const char*>(request.buffer);
+
+            // A read cut short by the end of the image still holds a complete short name
+            if (request.bytesRead > sizeof(uint16_t)) {
+                memcpy(&entry.ordinal, data, sizeof(uint16_t));
+                entry.name.assign(data + sizeof(uint16_t), strnlen(data + sizeof(uint16_t), request.bytesRead - sizeof(uint16_t)));
+            }
+            if (entry.name.empty()) entry.name = readImageString(pending.at(i).rva + sizeof(uint16_t));
+        }
+
+        // Index everything, the first module importing a name wins the name only key
+        for (size_t i = 0; i < m_imports.size(); i++) {
+            const Import& entry = m_imports.at(i);
+            std::string module = string::toLower(entry.module);
+            if (entry.isByOrdinal()) {
+                m_importIndex.emplace(std::format("{}#{}", module, entry.ordinal), i);
+            } else {
+                m_importIndex.emplace(entry.name, i);
+                m_importIndex.emplace(std::format("{}!{}", module, entry.name), i);
+            }
+        }
+    }
+
+    const std::vector<Import>& PeMap::imports()
+    {
+        if (!m_importsLoaded) loadImports();
+        return m_imports;
+    }
+
+    const Import* PeMap::findImport(std::string_view name)
+    {
+        if (!m_importsLoaded) loadImports();
+        auto found = m_importIndex.find(name);
+        return found == m_importIndex.end() ? nullptr : &m_imports.at(found->second);
+    }
+
+    const Import* PeMap::findImport(std::string_view module, std::string_view name)
+    {
+        return findImport(std::format("{}!{}", string::toLower(module), name));
+    }
+
+    const Import* PeMap::findImport(std::string_view module, uint16_t ordinal)
+    {
+        return findImport(std::format("{}#{}", string::toLower(module), ordinal));
     }
 } // namespace fatigue::pe
@@ -1,7 +1,13 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 #include "log.hpp"
+#include "MapIndex.hpp"
 #include "proc.hpp"
 #include "Region.hpp"
 
@@ -33,17 +39,242 @@ namespace fatigue::pe {
         uint16_t characteristics;
     };
 
+    // Data directory indexes
+    const size_t DIRECTORY_EXPORT = 0;
+    const size_t DIRECTORY_IMPORT = 1;
+    const size_t DIRECTORY_RESOURCE = 2;
+    const size_t DIRECTORY_EXCEPTION = 3;
+    const size_t DIRECTORY_SECURITY = 4;
+    const size_t DIRECTORY_BASERELOC = 5;
+    const size_t DIRECTORY_DEBUG = 6;
+    const size_t DIRECTORY_ARCHITECTURE = 7;
+    const size_t DIRECTORY_GLOBALPTR = 8;
+    const size_t DIRECTORY_TLS = 9;
+    const size_t DIRECTORY_LOAD_CONFIG = 10;
+    const size_t DIRECTORY_BOUND_IMPORT = 11;
+    const size_t DIRECTORY_IAT = 12;
+    const size_t DIRECTORY_DELAY_IMPORT = 13;
+    const size_t DIRECTORY_COM_DESCRIPTOR = 14;
+    const size_t DIRECTORY_COUNT = 16;
+
+    struct DataDirectory {
+        uint32_t virtualAddress;
+        uint32_t size;
+    };
+
+    /** Optional header of a PE32 image as laid out in memory, up to the data directories */
+    struct CoffOptionalHeader32 {
+        uint16_t magic;
+        uint8_t majorLinkerVersion;
+        uint8_t minorLinkerVersion;
+        uint32_t sizeOfCode;
+        uint32_t sizeOfInitializedData;
+        uint32_t sizeOfUninitializedData;
+        uint32_t addressOfEntryPoint;
+        uint32_t baseOfCode;
+        uint32_t baseOfData;
+        uint32_t imageBase;
+        uint32_t sectionAlignment;
+        uint32_t fileAlignment;
+        uint16_t majorOperatingSystemVersion;
+        uint16_t minorOperatingSystemVersion;
+        uint16_t majorImageVersion;
+        uint16_t minorImageVersion;
+        uint16_t majorSubsystemVersion;
+        uint16_t minorSubsystemVersion;
+        uint32_t win32VersionValue;
+        uint32_t sizeOfImage;
+        uint32_t sizeOfHeaders;
+        uint32_t checksum;
+        uint16_t subsystem;
+        uint16_t dllCharacteristics;
+        uint32_t sizeOfStackReserve;
+        uint32_t sizeOfStackCommit;
+        uint32_t sizeOfHeapReserve;
+        uint32_t sizeOfHeapCommit;
+        uint32_t loaderFlags;
+        uint32_t rvaSizes;
+    };
+    static_assert(sizeof(CoffOptionalHeader32) == 96);
+
+    /** Optional header of a PE32+ image as laid out in memory, up to the data directories */
+    struct CoffOptionalHeader64 {
+        uint16_t magic;
+        uint8_t majorLinkerVersion;
+        uint8_t minorLinkerVersion;
+        uint32_t sizeOfCode;
+        uint32_t sizeOfInitializedData;
+        uint32_t sizeOfUninitializedData;
+        uint32_t addressOfEntryPoint;
+        uint32_t baseOfCode;
+        uint64_t imageBase;
+        uint32_t sectionAlignment;
+        uint32_t fileAlignment;
+        uint16_t majorOperatingSystemVersion;
+        uint16_t minorOperatingSystemVersion;
+        uint16_t majorImageVersion;
+        uint16_t minorImageVersion;
+        uint16_t majorSubsystemVersion;
+        uint16_t minorSubsystemVersion;
+        uint32_t win32VersionValue;
+        uint32_t sizeOfImage;
+        uint32_t sizeOfHeaders;
+        uint32_t checksum;
+        uint16_t subsystem;
+        uint16_t dllCharacteristics;
+        uint64_t sizeOfStackReserve;
+        uint64_t sizeOfStackCommit;
+        uint64_t sizeOfHeapReserve;
+        uint64_t sizeOfHeapCommit;
+        uint32_t loaderFlags;
+        uint32_t rvaSizes;
+    };
+    static_assert(sizeof(CoffOptionalHeader64) == 112);
+
+    /**
+     * Optional header of either format, widened to the PE32+ field sizes
+     * baseOfData only exists in PE32 images, and is 0 for PE32+
+     */
     struct CoffOptionalHeader {
         uint16_t magic;
-        uint8_t ignored[104];
-        uint16_t rvaSizes;
+        uint8_t majorLinkerVersion;
+        uint8_t minorLinkerVersion;
+        uint32_t sizeOfCode;
+        uint32_t sizeOfInitializedData;
+        uint32_t sizeOfUninitializedData;
+        uint32_t addressOfEntryPoint;
+        uint32_t baseOfCode;
+        uint32_t baseOfData;
+        uint64_t imageBase;
+        uint32_t sectionAlignment;
+        uint32_t fileAlignment;
+        uint16_t majorOperatingSystemVersion;
+        uint16_t minorOperatingSystemVersion;
+        uint16_t majorImageVersion;
+        uint16_t minorImageVersion;
+        uint16_t majorSubsystemVersion;
+        uint16_t minorSubsystemVersion;
+        uint32_t win32VersionValue;
+        uint32_t sizeOfImage;
+        uint32_t sizeOfHeaders;
+        uint32_t checksum;
+        uint16_t subsystem;
+        uint16_t dllCharacteristics;
+        uint64_t sizeOfStackReserve;
+        uint64_t sizeOfStackCommit;
+        uint64_t sizeOfHeapReserve;
+        uint64_t sizeOfHeapCommit;
+        uint32_t loaderFlags;
+        uint32_t rvaSizes;
+
+        inline bool isPE32Plus() const { return magic == PE32PLUS_MAGIC; }
+    };
+
+    struct ExportDirectory {
+        uint32_t characteristics;
+        uint32_t timestamp;
+        uint16_t majorVersion;
+        uint16_t minorVersion;
+        uint32_t name;
+        uint32_t ordinalBase;
+        uint32_t functionCount;
+        uint32_t nameCount;
+        uint32_t functionsRva;
+        uint32_t namesRva;
+        uint32_t ordinalsRva;
     };
 
+    struct ImportDescriptor {
+        uint32_t lookupTableRva; // OriginalFirstThunk
+        uint32_t timestamp;
+        uint32_t forwarderChain;
+        uint32_t name;
+        uint32_t addressTableRva; // FirstThunk
+    };
+
+    /** Function exported by an image */
+    struct Export {
+        /** Exported name, empty if only exported by ordinal */
+        std::string name;
+        /** Ordinal (biased by the ordinal base, as used by GetProcAddress) */
+        uint32_t ordinal{0};
+        /** RVA of the function, or of the forwarder string if forwarded */
+        uint32_t rva{0};
+        /** Absolute address of the function in the process, 0 if forwarded */
+        uintptr_t address{0};
+        /** Target of a forwarded export, e.g. "NTDLL.RtlAllocateHeap" */
+        std::string forwarder;
+
+        inline bool isForwarded() const { return !forwarder.empty(); }
+    };
+
+    /** Function imported by an image, with its slot in the import address table (IAT) */
+    struct Import {
+        /** Name of the DLL as written in the import table, e.g. "KERNEL32.dll" */
+        std::string module;
+        /** Imported name, empty if imported by ordinal */
+        std::string name;
+        /** Ordinal if imported by ordinal, otherwise the name hint */
+        uint16_t ordinal{0};
+        /** Absolute address of the IAT entry the loader fills in */
+        uintptr_t slot{0};
+        /** Value of the IAT entry when the imports were read (the resolved function once loaded) */
+        uintptr_t address{0};
+
+        inline bool isByOrdinal() const { return name.empty(); }
+    };
+
+    /** Hash for string keyed maps that can be looked up with a string_view */
+    struct StringHash {
+        using is_transparent = void;
+        inline size_t operator()(std::string_view text) const { return std::hash<std::string_view>{}(text); }
+    };
+
+    // Section characteristics
+    const uint32_t SECTION_CODE = 0x00000020;
+    const uint32_t SECTION_INITIALIZED_DATA = 0x00000040;
+    const uint32_t SECTION_UNINITIALIZED_DATA = 0x00000080;
+    const uint32_t SECTION_MEM_SHARED = 0x10000000;
+    const uint32_t SECTION_MEM_EXECUTE = 0x20000000;
+    const uint32_t SECTION_MEM_READ = 0x40000000;
+    const uint32_t SECTION_MEM_WRITE = 0x80000000;
+
     struct SectionHeader {
         char name[8];
         uint32_t virtualSize;
         uint32_t virtualAddress;
-        uint8_t ignored[24]; // Allows a block read to fetch all section headers
+        uint32_t sizeOfRawData;
+        uint32_t pointerToRawData;
+        uint32_t pointerToRelocations;
+        uint32_t pointerToLinenumbers;
+        uint16_t relocationCount;
+        uint16_t linenumberCount;
+        uint32_t characteristics;
+    };
+    static_assert(sizeof(SectionHeader) == 40); // Allows a block read to fetch all section headers
+
+    /**
+     * Loaded section, precomputed from its header when the PeMap is initialized
+     * Names are trimmed, permissions are converted to proc::PERM_* bits, and the region is ready to
+     * read or scan (copies share nothing but the name).
+     */
+    struct Section {
+        std::string name;
+        uint32_t virtualAddress{0};
+        /** Size in memory (the raw size if the header leaves the virtual size empty) */
+        uint32_t virtualSize{0};
+        uint32_t characteristics{0};
+        /** Permissions as proc::PERM_READ, PERM_WRITE, PERM_EXEC bits */
+        uint8_t perms{0};
+        Region region{};
+
+        inline bool isCode() const { return characteristics & SECTION_CODE; }
+        inline bool has(uint8_t wanted) const { return (perms & wanted) == wanted; }
+        /** Check if [rva, rva + size) is inside the section */
+        inline bool contains(uint32_t rva, size_t size = 1) const
+        {
+            return rva >= virtualAddress && static_cast<uint64_t>(rva) + size <= static_cast<uint64_t>(virtualAddress) + virtualSize;
+        }
     };
 
     bool isValidPE(pid_t pid, uintptr_t address);
@@ -51,10 +282,40 @@ namespace fatigue::pe {
 
     class PeMap : public proc::Map {
     protected:
+        using Index = std::unordered_map<std::string, size_t, StringHash, std::equal_to<>>;
+
         DosHeader m_dos{0};
         CoffHeader m_coff{0};
         CoffOptionalHeader m_optional{0};
+        std::array<DataDirectory, DIRECTORY_COUNT> m_directories{};
         std::vector<SectionHeader> m_sections{};
+        /** Sections sorted by address, built once by init() */
+        std::vector<Section> m_sectionTable{};
+        /** Regions of m_sectionTable, in the same order (@see getSections) */
+        std::vector<Region> m_sectionRegions{};
+
+        void buildSectionTable();
+
+        bool m_exportsLoaded{false};
+        std::vector<Export> m_exports{};
+        /** Export index by name */
+        Index m_exportNames{};
+        /** Export index by ordinal */
+        std::unordered_map<uint32_t, size_t> m_exportOrdinals{};
+
+        bool m_importsLoaded{false};
+        std::vector<Import> m_imports{};
+        /** Import index by name, "module!name" and "module#ordinal" (module in lower case) */
+        Index m_importIndex{};
+
+        /** Read from the image at an RVA without throwing, returns the number of bytes read */
+        size_t readImage(uint32_t rva, void* buffer, size_t size) const;
+        /** Read a NUL terminated string from the image at an RVA */
+        std::string readImageString(uint32_t rva, size_t maxLength = 512) const;
+
+        void loadExports();
+        void loadImports();
+
     public:
         PeMap() = default;
         PeMap(proc::Map& map, bool autoInit = true) : proc::Map(map) {
@@ -69,6 +330,12 @@ namespace fatigue::pe {
         CoffOptionalHeader optional() const { return m_optional; }
         std::vector<SectionHeader> sections() const { return m_sections; }
 
+        /** Get a data directory (e.g. DIRECTORY_EXPORT), empty if the image does not have it */
+        inline DataDirectory directory(size_t index) const
+        {
+            return index < m_directories.size() ? m_directories.at(index) : DataDirectory{0, 0};
+        }
+
         void init();
 
         inline bool isValidDos() const { return m_dos.magic == DOS_MAGIC; }
@@ -80,7 +347,79 @@ namespace fatigue::pe {
             return proc::Map::isValid() && isValidDos() && isValidCoff() && isValidOptional();
         }
 
-        std::vector<Region> getSections();
-        Region getSection(const std::string_view &name = ".text");
+        /**
+         * @brief Get a region spanning the whole loaded image (SizeOfImage)
+         * The map of an image usually only covers the headers, with the sections mapped after it
+         */
+        Region image() const;
+
+        // Sections
+
+        /** Get the loaded sections, sorted by address */
+        inline const std::vector<Section>& sectionTable() const { return m_sectionTable; }
+
+        /** Get the section containing an RVA, nullptr if it is not in any section (binary search) */
+        const Section* rvaToSection(uint32_t rva) const;
+        /** Get the section containing an absolute address, nullptr if it is not in any section */
+        inline const Section* vaToSection(uintptr_t address) const
+        {
+            if (address < start || address - start > UINT32_MAX) return nullptr;
+            return rvaToSection(static_cast<uint32_t>(address - start));
+        }
+        /**
+         * Check if [address, address + size) lies in one section with the wanted permissions
+         * @param perms proc::PERM_* bits the section must have, e.g. PERM_READ | PERM_WRITE
+         */
+        inline bool isValidAddress(uintptr_t address, size_t size = 1, uint8_t perms = 0) const
+        {
+            const Section* section = vaToSection(address);
+            return section && section->contains(static_cast<uint32_t>(address - start), size) && section->has(perms);
+        }
+
+        /** Find a section by name; a name with a leading dot also matches without it (e.g. "text") */
+        const Section* findSection(std::string_view name) const;
+
+        /** Get all sections as regions (cached by init) */
+        inline const std::vector<Region>& getSections() const { return m_sectionRegions; }
+        /** Get a section as a region, an invalid region if not found */
+        Region getSection(const std::string_view &name = ".text") const;
+
+        /**
+         * @brief Hash the headers and optionally the contents of some sections, to identify a build
+         * The headers (SizeOfHeaders bytes: timestamp, checksum, section table, ...) are one small read
+         * and already tell builds apart. Sections are streamed through a buffer of Region::chunkSize
+         * bytes with XXH64, so even a large .text costs little memory. Section contents are live
+         * memory: hash them before patching (or to check nothing was patched).
+         * @param sections Names of the sections to hash as well, e.g. {".text"} (@see findSection)
+         * @return XXH64 of the headers and sections, 0 if the image is not valid
+         */
+        uint64_t fingerprint(const std::vector<std::string>& sections = {}) const;
+
+        // Exports and imports, read on first use and indexed for constant time lookups
+
+        /** Get all exported functions */
+        const std::vector<Export>& exports();
+        /** Find an export by name, nullptr if not exported */
+        const Export* findExport(std::string_view name);
+        /** Find an export by ordinal, nullptr if not exported */
+        const Export* findExport(uint32_t ordinal);
+        /**
+         * Get the absolute address of an exported function, like GetProcAddress
+         * @return 0 if not exported, or forwarded to another DLL (@see Export::forwarder)
+         */
+        inline uintptr_t getExportAddress(std::string_view name)
+        {
+            const Export* found = findExport(name);
+            return found ? found->address : 0;
+        }
+
+        /** Get all imported functions */
+        const std::vector<Import>& imports();
+        /** Find an import by name from any module, nullptr if not imported */
+        const Import* findImport(std::string_view name);
+        /** Find an import by module (case insensitive, e.g. "kernel32.dll") and name */
+        const Import* findImport(std::string_view module, std::string_view name);
+        /** Find an import by module (case insensitive) and ordinal */
+        const Import* findImport(std::string_view module, uint16_t ordinal);
     };
 } // namespace fatigue::pe
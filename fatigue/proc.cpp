@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <chrono>
 #include <filesystem>
 #include <fstream>
@@ -85,78 +86,142 @@ namespace fatigue::proc {
 
     // Process ID
 
-    pid_t getProcessID(const std::string& processName, std::function<bool(pid_t)> filter)
+    pid_t getProcessId(const std::string& processName, std::function<bool(pid_t)> filter)
     {
-        if (processName.empty()) return 0;
-
-        pid_t pid = 0;
-
-        const std::filesystem::path proc{"/proc/"};
-        for (auto const& entry : std::filesystem::directory_iterator{proc}) {
-            if (entry.is_directory()) {
-                pid_t entryPid = atoi(entry.path().filename().c_str());
-                if (entryPid > 0) {
-                    if (filter(entryPid)) {
-                        pid = entryPid;
-                        break;
-                    }
-                }
-            }
-
-        }
+        if (processName.empty() || !filter) return 0;
 
-        return pid;
+        ProcessScanner scanner(filter);
+        return scanner.scan();
     }
 
     pid_t getProcessId(const std::string& cmdline) {
-        return getProcessID(cmdline, [&](const int checkPid) {
-            return getCmdline(checkPid) == cmdline;
-        });
+        return getProcessId(cmdline, matchCmdline(cmdline));
     }
 
     pid_t getProcessIdByStatusName(const std::string& processName)
     {
-        return getProcessID(processName, [&](const int checkPid) {
-            return getStatusName(checkPid) == processName;
-        });
+        return getProcessId(processName, matchStatusName(processName));
     }
 
     pid_t getProcessIdByCmdlineEndsWith(const std::string& processName)
     {
-        return getProcessID(processName, [&](const int checkPid) {
-            return getCmdline(checkPid).ends_with(processName);
-        });
+        return getProcessId(processName, matchCmdlineEndsWith(processName));
     }
 
     pid_t getProcessIdByCmdlineContains(const std::string& processName)
     {
-        return getProcessID(processName, [&](const int checkPid) {
-            std::string cmdline = getCmdline(checkPid);
-            if (cmdline.contains("Crab")) {
-                logInfo(std::format("Checking {} for {}\n{}\n",
-                                    checkPid, processName,
-                                    cmdline, cmdline.contains(processName) ? "true" : "false"));
-            }
-            return getCmdline(checkPid).contains(processName);
-        });
+        return getProcessId(processName, matchCmdlineContains(processName));
     }
 
-    pid_t waitForProcess(std::function<pid_t()> getter, u_int timeout, u_int interval)
+    std::vector<ProcessInfo> findProcesses(std::function<bool(pid_t)> filter)
     {
-        if (!getter) return 0;
-        if (timeout <= 0) return getter();
+        std::vector<ProcessInfo> processes;
+        if (!filter) return processes;
+
+        ProcessScanner scanner(filter);
+        for (pid_t pid : scanner.scanAll()) {
+            ProcessInfo info = getProcessInfo(pid);
+            // Skip processes that exited since the scan
+            if (info.pid > 0) processes.push_back(std::move(info));
+        }
+        return processes;
+    }
 
-        pid_t pid = 0;
-        while (pid <= 0) {
-            pid = getter();
-            if (pid <= 0) {
-                if (timeout-- <= 0) {
-                    break;
+    bool mapsImage(pid_t pid, const std::string& name)
+    {
+        if (pid <= 0 || name.empty()) return false;
+
+        MapTable table(pid);
+        for (const MapEntry& entry : table) {
+            if (entry.offset != 0 || !entry.isRead() || !entry.name.ends_with(name)) continue;
+            return pe::isValidPE(pid, entry.start) || elf::isValidElf(pid, entry.start);
+        }
+        return false;
+    }
+
+    pid_t rankProcesses(const std::vector<ProcessInfo>& processes, const ProcessRanking& ranking)
+    {
+        const ProcessInfo* best = nullptr;
+
+        for (const ProcessInfo& process : processes) {
+            if (best && (ranking.newest ? process.startTime <= best->startTime : process.startTime >= best->startTime)) continue;
+            if (!ranking.image.empty() && !mapsImage(process.pid, ranking.image)) continue;
+            best = &process;
+        }
+
+        return best ? best->pid : 0;
+    }
+
+    namespace {
+        /** Polling starts this fast when there are no process events, and backs off to s_maxPollGap */
+        const std::chrono::milliseconds s_minPollGap{10};
+        const std::chrono::milliseconds s_maxPollGap{250};
+
+        /**
+         * Call check until it finds a process or the deadline passes
+         * With the proc connector, check runs as soon as a process execs or renames itself (with the
+         * pid that did), and a full check (pid 0) runs at least every maxGap, events or not. Otherwise it runs on an adaptive sub-second timer.
+         */
+        pid_t waitUntil(std::function<pid_t(pid_t)> check, std::chrono::steady_clock::time_point deadline,
+                        std::chrono::milliseconds maxGap)
+        {
+            ExecMonitor monitor;
+            bool listening = monitor.isListening();
+            std::chrono::milliseconds gap = std::min(s_minPollGap, maxGap);
+
+            pid_t pid = check(0);
+            auto lastFull = std::chrono::steady_clock::now();
+            while (pid <= 0) {
+                auto now = std::chrono::steady_clock::now();
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now);
+                if (left.count() <= 0) break;
+
+                if (listening) {
+                    // Wait no longer than until the next full check is due
+                    auto due = std::chrono::duration_cast<std::chrono::milliseconds>(lastFull + maxGap - now);
+                    pid_t event = monitor.next(static_cast<int>(std::clamp(due, std::chrono::milliseconds(0), left).count()));
+                    if (event > 0) {
+                        pid = check(event);
+                        // A steady stream of unrelated events must not put off the full check, which
+                        // catches events that were missed or coalesced
+                        if (pid > 0 || std::chrono::steady_clock::now() - lastFull < maxGap) continue;
+                    }
+                    // Stop relying on the socket if it fails, and poll instead
+                    if (event < 0) listening = false;
+                } else {
+                    std::this_thread::sleep_for(std::min(left, gap));
+                    gap = std::min({gap * 2, s_maxPollGap, maxGap});
                 }
-                std::this_thread::sleep_for(std::chrono::seconds(interval));
+                pid = check(0);
+                lastFull = std::chrono::steady_clock::now();
             }
+            return pid;
         }
-        return pid;
+    } // namespace
+
+    pid_t waitForProcess(std::function<pid_t()> getter, u_int timeout, u_int interval)
+    {
+        if (!getter) return 0;
+        if (timeout <= 0) return getter();
+
+        // Same overall wait as before (timeout checks, interval seconds apart), but the getter now runs
+        // whenever a process starts, and interval is only the longest gap between checks
+        interval = std::max(interval, 1u);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeout * interval);
+
+        return waitUntil([&getter](pid_t) { return getter(); }, deadline, std::chrono::seconds(interval));
+    }
+
+    pid_t waitForProcess(ProcessScanner& scanner, u_int timeout, u_int intervalMs)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeout);
+        if (timeout <= 0) return scanner.scan();
+
+        // A reported process is checked on its own, a full scan only runs when nothing was reported
+        return waitUntil([&scanner](pid_t event) {
+            if (event > 0) return scanner.matches(event) ? event : 0;
+            return scanner.scan();
+        }, deadline, std::chrono::milliseconds(std::max(intervalMs, 1u)));
     }
 
     void wait(u_int ms)
@@ -166,38 +231,44 @@ namespace fatigue::proc {
 
     // Maps
 
-    std::vector<Map> getMaps(pid_t pid, std::function<bool(Map&)> filter)
-    {
-        std::vector<Map> maps{};
-        if (pid <= 0) return maps;
+    namespace {
+        /** Build Maps only for the entries that pass a cheap check on the unparsed fields */
+        std::vector<Map> collectMaps(pid_t pid, std::function<bool(const MapEntry&)> check)
+        {
+            std::vector<Map> maps{};
+            if (pid <= 0) return maps;
 
-        std::filesystem::path path = std::format("/proc/{}/maps", pid);
-        std::ifstream file(path);
-        if (!file.is_open()) {
-            logError(std::format("Error opening {}", path.c_str()));
+            MapTable table(pid);
+            for (const MapEntry& entry : table) {
+                if (check(entry)) maps.push_back(entry.toMap(pid));
+            }
             return maps;
         }
 
-        try {
-            std::string line;
-            while (std::getline(file, line)) {
-                Map map{};
-                map.pid = pid;
+        /** Find the first entry that passes a check, without building the others */
+        Map firstMap(pid_t pid, std::function<bool(const MapEntry&)> check)
+        {
+            if (pid <= 0) return Map{};
 
-                // Throwaway variable for the dash
-                char dash;
-                // (format) start-end perms offset dev inode pathname
-                std::istringstream iss{line};
-                iss >> std::hex >> map.start >> dash >> map.end
-                    >> map.perms >> map.offset >> map.dev
-                    >> std::dec >> map.inode >> map.name;
+            MapTable table(pid);
+            for (const MapEntry& entry : table) {
+                if (check(entry)) return entry.toMap(pid);
+            }
+            return Map{};
+        }
+    } // namespace
 
-                if (!filter || filter(map)) {
-                    maps.push_back(map);
-                }
+    std::vector<Map> getMaps(pid_t pid, std::function<bool(Map&)> filter)
+    {
+        std::vector<Map> maps{};
+        if (pid <= 0) return maps;
+
+        MapTable table(pid);
+        for (const MapEntry& entry : table) {
+            Map map = entry.toMap(pid);
+            if (!filter || filter(map)) {
+                maps.push_back(std::move(map));
             }
-        } catch (const std::exception& e) {
-            logError(std::format("Error reading {}: {}", path.c_str(), e.what()));
         }
 
         return maps;
@@ -205,37 +276,37 @@ namespace fatigue::proc {
 
     std::vector<Map> getValidMaps(pid_t pid)
     {
-        return getMaps(pid, [](Map& map) {
-            return map.isValid() && !map.isAnonymous();
+        return collectMaps(pid, [](const MapEntry& entry) {
+            return entry.isValid() && !entry.isAnonymous();
         });
     }
 
     std::vector<Map> getMaps(pid_t pid, const std::string& name)
     {
-        return getMaps(pid, [&name](Map& map) {
-            return map.isValid() && map.name.contains(name);
+        return collectMaps(pid, [&name](const MapEntry& entry) {
+            return entry.isValid() && entry.name.contains(name);
         });
     }
 
     std::vector<Map> getMapsEndsWith(pid_t pid, const std::string& name)
     {
-        return getMaps(pid, [&name](Map& map) {
-            return map.isValid() && map.name.ends_with(name);
+        return collectMaps(pid, [&name](const MapEntry& entry) {
+            return entry.isValid() && entry.name.ends_with(name);
         });
     }
 
     Map findMap(pid_t pid, const std::string& name)
     {
-        std::vector<Map> maps = getMaps(pid, name);
-        if (maps.empty()) return Map{};
-        return maps.front();
+        return firstMap(pid, [&name](const MapEntry& entry) {
+            return entry.isValid() && entry.name.contains(name);
+        });
     }
 
     Map findMapEndsWith(pid_t pid, const std::string& name)
     {
-        std::vector<Map> maps = getMapsEndsWith(pid, name);
-        if (maps.empty()) return Map{};
-        return maps.front();
+        return firstMap(pid, [&name](const MapEntry& entry) {
+            return entry.isValid() && entry.name.ends_with(name);
+        });
     }
 
     // Attach and detach
@@ -5,6 +5,8 @@
 #include <map>
 #include <string>
 #include <vector>
+#include "ExecMonitor.hpp"
+#include "ProcessScanner.hpp"
 #include "Region.hpp"
 
 namespace fatigue::proc {
@@ -94,12 +96,52 @@ namespace fatigue::proc {
      */
     pid_t getProcessIdByStatusName(const std::string& cmdline);
 
+    /**
+     * Find every process accepted by a filter in a single /proc scan, with its info
+     * Useful when several processes match (e.g. under Proton, the preloader, wineserver
+     * children, and a launcher may all mention the exe), see rankProcesses()
+     * @param filter e.g. matchStatusName() or matchCmdlineContains()
+     */
+    std::vector<ProcessInfo> findProcesses(std::function<bool(pid_t)> filter);
+
+    /** How rankProcesses() picks one process out of several */
+    struct ProcessRanking {
+        /** Only consider processes that map a valid PE or ELF image ending with this name (empty for any) */
+        std::string image;
+        /** Prefer the most recently started process, otherwise the oldest */
+        bool newest{true};
+    };
+
+    /**
+     * Check if a process maps a valid PE or ELF image whose path ends with a name
+     * (the image headers are checked at offset 0 of the first matching map)
+     */
+    bool mapsImage(pid_t pid, const std::string& name);
+
+    /**
+     * Pick the best process out of several candidates
+     * @return Pid of the best candidate, 0 if none qualifies
+     */
+    pid_t rankProcesses(const std::vector<ProcessInfo>& processes, const ProcessRanking& ranking = {});
+
     /**
      * Wait for a process to appear using one of the getProcess* functions
-     * optionally with a timeout
+     * optionally with a timeout (in checks interval seconds apart, as always)
+     * The getter runs again as soon as any process execs or renames itself if the kernel proc
+     * connector is available (@see ExecMonitor), otherwise on a sub-second timer; interval is the
+     * longest time between two checks.
      */
     pid_t waitForProcess(std::function<pid_t()> get, u_int timeout = 0, u_int interval = 1);
 
+    /**
+     * Wait for a process to appear using a ProcessScanner
+     * Processes reported by the proc connector are checked on their own the moment they exec;
+     * without it (or in between events) /proc is scanned, skipping pids already rejected.
+     * @param timeout Seconds to wait, 0 to scan only once
+     * @param intervalMs Longest time in milliseconds between full scans
+     */
+    pid_t waitForProcess(ProcessScanner& scanner, u_int timeout = 0, u_int intervalMs = 50);
+
     /**
      * Sleep for a number of milliseconds
      * Useful if the process needs a moment to start up
@@ -109,6 +151,7 @@ namespace fatigue::proc {
     /**
      * Get all maps in /proc/[pid]/maps
      * Optionally, provide a custom comparator to filter maps, e.g. by pathname
+     * (to walk the maps without building a Map for each one, iterate a MapTable instead)
      */
     std::vector<Map> getMaps(pid_t pid, std::function<bool(Map&)> filter = nullptr);
 
@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include "scan.hpp"
+
+namespace fatigue::scan {
+
+    std::atomic<unsigned> s_threads{1};
+
+    void setThreadCount(unsigned threads) { s_threads = threads; }
+    unsigned getThreadCount() { return s_threads; }
+
+    unsigned resolveThreadCount(unsigned threads)
+    {
+        if (threads == 0) threads = std::thread::hardware_concurrency();
+        return std::max(threads, 1u);
+    }
+
+    namespace {
+        /** One unit of work: matches starting in [offset, offset + length) of a region */
+        struct Chunk {
+            size_t region;
+            size_t offset;
+            size_t length;
+        };
+
+        std::vector<std::vector<uintptr_t>> run(const std::vector<Region>& regions, const search::Pattern& pattern,
+                                                bool first, unsigned threads, std::vector<Chunk>& chunks)
+        {
+            const size_t patternSize = pattern.bytes.size();
+
+            // Workers cannot throw, so reject bad patterns up front
+            if (!pattern.mask.empty() && pattern.mask.at(0) == '?')
+                throw std::invalid_argument("Mask should not start with a wildcard");
+
+            // Partition every region, in order, so chunk order is address order within each region
+            for (size_t r = 0; r < regions.size(); r++) {
+                const Region& region = regions.at(r);
+                if (!region.isValid() || region.size() < patternSize) continue;
+
+                size_t chunkSize = region.chunkSize > 0 ? region.chunkSize : DEFAULT_SCAN_CHUNK_SIZE;
+                for (size_t offset = 0; offset < region.size(); offset += chunkSize) {
+                    chunks.push_back({r, offset, std::min(chunkSize, region.size() - offset)});
+                }
+            }
+
+            std::vector<std::vector<uintptr_t>> results(chunks.size());
+            std::atomic<size_t> next{0};
+            // With first, the lowest chunk index that found a match; later chunks can be skipped
+            std::atomic<size_t> best{SIZE_MAX};
+
+            auto worker = [&]() {
+                std::vector<uint8_t> buffer;
+                mem::PageBitmap holes;
+
+                for (size_t i = next++; i < chunks.size(); i = next++) {
+                    if (first && i > best) break;
+
+                    const Chunk& chunk = chunks.at(i);
+                    const Region& region = regions.at(chunk.region);
+
+                    // Read past the end of the chunk so patterns starting near its end are seen whole
+                    size_t extent = std::min(chunk.length + patternSize - 1, region.size() - chunk.offset);
+                    buffer.resize(extent);
+
+                    // Unreadable pages are zero filled and flagged, search only the readable stretches
+                    try {
+                        region.readSparse(chunk.offset, buffer.data(), extent, &holes);
+                    } catch (const std::exception& e) {
+                        logWarning(std::format("Scan failed to read {:#x}-{:#x}: {}",
+                                               region.start + chunk.offset, region.start + chunk.offset + extent, e.what()));
+                        continue;
+                    }
+
+                    for (auto& [runOffset, runLength] : holes.readable()) {
+                        if (runOffset >= chunk.length) break;
+                        for (auto match : search::search(buffer.data() + runOffset, runLength, pattern, first)) {
+                            if (runOffset + match >= chunk.length) break;
+                            results.at(i).push_back(chunk.offset + runOffset + match);
+                            if (first) break;
+                        }
+                        if (first && !results.at(i).empty()) break;
+                    }
+
+                    if (first && !results.at(i).empty()) {
+                        // Lower the cancellation mark to this chunk if it is the earliest hit so far
+                        size_t current = best;
+                        while (i < current && !best.compare_exchange_weak(current, i)) {}
+                    }
+                }
+            };
+
+            threads = std::min<size_t>(resolveThreadCount(threads), std::max<size_t>(chunks.size(), 1));
+            if (threads <= 1) {
+                worker();
+            } else {
+                std::vector<std::jthread> pool;
+                pool.reserve(threads);
+                for (unsigned t = 0; t < threads; t++) pool.emplace_back(worker);
+            }
+
+            return results;
+        }
+    } // namespace
+
+    std::vector<uintptr_t> find(const Region& region, const search::Pattern& pattern, bool first, unsigned threads)
+    {
+        if (!region.isValid() || pattern.bytes.empty()) return {};
+
+        std::vector<Chunk> chunks;
+        auto results = run({region}, pattern, first, threads == 0 ? getThreadCount() : threads, chunks);
+
+        std::vector<uintptr_t> found;
+        for (auto& result : results) {
+            found.insert(found.end(), result.begin(), result.end());
+            if (first && !found.empty()) {
+                found.resize(1);
+                break;
+            }
+        }
+        return found;
+    }
+
+    std::vector<uintptr_t> find(const std::vector<Region>& regions, const search::Pattern& pattern, bool first, unsigned threads)
+    {
+        if (regions.empty() || pattern.bytes.empty()) return {};
+
+        std::vector<Chunk> chunks;
+        auto results = run(regions, pattern, first, threads == 0 ? getThreadCount() : threads, chunks);
+
+        std::vector<uintptr_t> found;
+        for (size_t i = 0; i < results.size(); i++) {
+            uintptr_t base = regions.at(chunks.at(i).region).start;
+            for (auto match : results.at(i)) {
+                found.push_back(base + match);
+                if (first) return found;
+            }
+        }
+        return found;
+    }
+
+    std::vector<uintptr_t> find(const std::vector<proc::Map>& maps, const search::Pattern& pattern, bool first, unsigned threads)
+    {
+        return find(std::vector<Region>(maps.begin(), maps.end()), pattern, first, threads);
+    }
+} // namespace fatigue::scan
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "proc.hpp"
+#include "Region.hpp"
+#include "utils.hpp"
+
+/**
+ * Parallel pattern scanning over large regions
+ * Regions are partitioned into overlapping chunks which are handed out to a pool of worker threads.
+ * Each worker reads its own chunk (using the region's access method) and searches it; results are
+ * merged back in address order.
+ */
+namespace fatigue::scan {
+    /**
+     * Set the number of worker threads used for scans
+     * 0 uses one thread per hardware thread, 1 (the default) keeps scans single threaded
+     */
+    void setThreadCount(unsigned threads);
+    unsigned getThreadCount();
+    /** Resolve a thread count request (e.g. 0) to the number of workers that will actually run */
+    unsigned resolveThreadCount(unsigned threads);
+
+    /**
+     * Find a pattern in a region using multiple threads
+     * @param region Region to search
+     * @param pattern Byte pattern to search for (@see fatigue::search::parsePattern)
+     * @param first If true, return only the first match (remaining work is cancelled)
+     * @param threads Number of workers, 0 to use getThreadCount()
+     * @return Offsets from the start of the region, in ascending order
+     */
+    std::vector<uintptr_t> find(const Region& region, const search::Pattern& pattern, bool first = false, unsigned threads = 0);
+
+    /**
+     * Find a pattern in several regions (e.g. all readable maps) using multiple threads
+     * Chunks of all regions share the same pool, so many small regions scan as fast as one big one
+     * @param regions Regions to search
+     * @param pattern Byte pattern to search for (@see fatigue::search::parsePattern)
+     * @param first If true, return only the first match in region order (remaining work is cancelled)
+     * @param threads Number of workers, 0 to use getThreadCount()
+     * @return Absolute addresses, in the order of the regions and ascending within each region
+     */
+    std::vector<uintptr_t> find(const std::vector<Region>& regions, const search::Pattern& pattern, bool first = false, unsigned threads = 0);
+
+    /** @see find(const std::vector<Region>&, const search::Pattern&, bool, unsigned) */
+    std::vector<uintptr_t> find(const std::vector<proc::Map>& maps, const search::Pattern& pattern, bool first = false, unsigned threads = 0);
+} // namespace fatigue::scan
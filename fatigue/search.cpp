@@ -0,0 +1,362 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+#include "utils.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FATIGUE_SEARCH_X86 1
+#include <immintrin.h>
+#else
+#define FATIGUE_SEARCH_X86 0
+#endif
+
+namespace fatigue::search {
+
+    std::atomic<Engine> s_engine{Engine::Auto};
+
+    void setEngine(Engine engine) { s_engine = engine; }
+    Engine getEngine() { return s_engine; }
+
+    Engine resolveEngine(Engine engine)
+    {
+#if FATIGUE_SEARCH_X86
+        static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+        static const bool hasSse2 = __builtin_cpu_supports("sse2");
+
+        if ((engine == Engine::Auto || engine == Engine::AVX2) && hasAvx2) return Engine::AVX2;
+        if (engine != Engine::Scalar && hasSse2) return Engine::SSE2;
+#endif
+        return Engine::Scalar;
+    }
+
+    namespace {
+        /**
+         * Bytes that show up the most in x86/x64 machine code and data, most common first
+         * Used to pick the rarest needle bytes as candidate filters; anything not listed is "rare"
+         */
+        constexpr uint8_t commonBytes[] = {
+            0x00, 0xFF, 0x48, 0x8B, 0x89, 0x0F, 0x24, 0x44, 0x4C, 0x85, 0xE8, 0x01,
+            0xC0, 0x74, 0x83, 0x8D, 0x45, 0x75, 0x10, 0x08, 0x20, 0x41, 0x49, 0x4D,
+            0x04, 0x18, 0x28, 0x30, 0x38, 0x40, 0x50, 0x58, 0x60, 0x70, 0x80, 0x84,
+            0xC3, 0xCC, 0x90, 0x02, 0x03, 0x05, 0x0C, 0x14, 0x1C, 0x33, 0x3B, 0x39,
+            0x31, 0x29, 0xC7, 0xC6, 0xE9, 0xEB, 0xF3, 0x66, 0xF2, 0x0D, 0x5C, 0x54,
+        };
+
+        constexpr int byteRank(uint8_t byte)
+        {
+            for (size_t i = 0; i < sizeof(commonBytes); i++) {
+                if (commonBytes[i] == byte) return static_cast<int>(sizeof(commonBytes) - i);
+            }
+            return 0;
+        }
+
+        /**
+         * Needle and mask flattened for scanning
+         * Holds the checked (non-wildcard) positions and the two rarest of them, used as anchors
+         */
+        struct Compiled {
+            const uint8_t* bytes{nullptr};
+            size_t size{0};
+            std::vector<uint32_t> checked{};
+            size_t anchor1{0};
+            size_t anchor2{0};
+
+            Compiled(const uint8_t* needle, size_t needleSize, std::string_view mask)
+                : bytes(needle), size(needleSize)
+            {
+                checked.reserve(size);
+                for (size_t j = 0; j < size; j++) {
+                    if (mask.length() > j && mask[j] == '?') continue;
+                    checked.push_back(static_cast<uint32_t>(j));
+                }
+
+                // Pick the rarest and second rarest checked bytes (ties favour spread out positions)
+                if (checked.empty()) return;
+                anchor1 = anchor2 = checked.front();
+                for (auto j : checked) {
+                    if (byteRank(bytes[j]) < byteRank(bytes[anchor1])) anchor1 = j;
+                }
+                bool haveSecond = false;
+                for (auto j : checked) {
+                    if (j == anchor1) continue;
+                    if (!haveSecond || byteRank(bytes[j]) < byteRank(bytes[anchor2])
+                        || (byteRank(bytes[j]) == byteRank(bytes[anchor2]) && j > anchor2)) {
+                        anchor2 = j;
+                        haveSecond = true;
+                    }
+                }
+                if (!haveSecond) anchor2 = anchor1;
+            }
+
+            /** Check the full needle at a candidate position */
+            inline bool matches(const uint8_t* h) const
+            {
+                for (auto j : checked) {
+                    if (h[j] != bytes[j]) return false;
+                }
+                return true;
+            }
+        };
+
+        /**
+         * Verify candidates from [from, to) one by one, used by the scalar engine and for vector tails
+         * @return false if searching should stop (first match found)
+         */
+        bool scanScalar(const uint8_t* h, size_t from, size_t to, const Compiled& needle,
+                        bool first, std::vector<uintptr_t>& found)
+        {
+            const uint8_t rare = needle.bytes[needle.anchor1];
+            const size_t a = needle.anchor1;
+
+            for (size_t i = from; i < to; i++) {
+                // Skip straight to the next occurrence of the rarest byte
+                const void* next = memchr(h + i + a, rare, to - i);
+                if (!next) break;
+                i = static_cast<const uint8_t*>(next) - h - a;
+
+                if (needle.matches(h + i)) {
+                    found.push_back(i);
+                    if (first) return false;
+                }
+            }
+
+            return true;
+        }
+
+#if FATIGUE_SEARCH_X86
+        __attribute__((target("sse2")))
+        bool scanSse2(const uint8_t* h, size_t from, size_t to, const Compiled& needle,
+                      bool first, std::vector<uintptr_t>& found)
+        {
+            const __m128i b1 = _mm_set1_epi8(static_cast<char>(needle.bytes[needle.anchor1]));
+            const __m128i b2 = _mm_set1_epi8(static_cast<char>(needle.bytes[needle.anchor2]));
+
+            size_t i = from;
+            for (; i + 16 <= to; i += 16) {
+                __m128i c1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(h + i + needle.anchor1));
+                __m128i c2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(h + i + needle.anchor2));
+                uint32_t bits = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(c1, b1), _mm_cmpeq_epi8(c2, b2)));
+
+                while (bits) {
+                    size_t pos = i + __builtin_ctz(bits);
+                    if (needle.matches(h + pos)) {
+                        found.push_back(pos);
+                        if (first) return false;
+                    }
+                    bits &= bits - 1;
+                }
+            }
+
+            return scanScalar(h, i, to, needle, first, found);
+        }
+
+        __attribute__((target("avx2")))
+        bool scanAvx2(const uint8_t* h, size_t from, size_t to, const Compiled& needle,
+                      bool first, std::vector<uintptr_t>& found)
+        {
+            const __m256i b1 = _mm256_set1_epi8(static_cast<char>(needle.bytes[needle.anchor1]));
+            const __m256i b2 = _mm256_set1_epi8(static_cast<char>(needle.bytes[needle.anchor2]));
+
+            size_t i = from;
+            for (; i + 32 <= to; i += 32) {
+                __m256i c1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(h + i + needle.anchor1));
+                __m256i c2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(h + i + needle.anchor2));
+                uint32_t bits = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(c1, b1), _mm256_cmpeq_epi8(c2, b2)));
+
+                while (bits) {
+                    size_t pos = i + __builtin_ctz(bits);
+                    if (needle.matches(h + pos)) {
+                        found.push_back(pos);
+                        if (first) return false;
+                    }
+                    bits &= bits - 1;
+                }
+            }
+
+            return scanSse2(h, i, to, needle, first, found);
+        }
+#endif
+    } // namespace
+
+    std::vector<uintptr_t> search(const void* haystack, size_t haystackSize,
+                                  const void* needle, size_t needleSize,
+                                  std::string_view mask, bool first)
+    {
+        std::vector<uintptr_t> found = {};
+
+        if (!mask.empty() && mask.at(0) == '?')
+            throw std::invalid_argument("Mask should not start with a wildcard");
+
+        if (!haystack || !needle || haystackSize < 1 || needleSize < 1 || needleSize > haystackSize)
+            return found;
+
+        const uint8_t* h = static_cast<const uint8_t*>(haystack);
+        Compiled compiled(static_cast<const uint8_t*>(needle), needleSize, mask);
+
+        // Every start position in [0, last) leaves room for the whole needle
+        const size_t last = haystackSize - needleSize + 1;
+
+        switch (resolveEngine(getEngine())) {
+#if FATIGUE_SEARCH_X86
+        case Engine::AVX2:
+            scanAvx2(h, 0, last, compiled, first, found);
+            break;
+        case Engine::SSE2:
+            scanSse2(h, 0, last, compiled, first, found);
+            break;
+#endif
+        default:
+            scanScalar(h, 0, last, compiled, first, found);
+            break;
+        }
+
+        return found;
+    }
+
+    // MultiPattern
+
+    MultiPattern::MultiPattern(std::span<const Pattern> patterns)
+    {
+        m_entries.reserve(patterns.size());
+        for (auto& pattern : patterns) {
+            m_entries.push_back({pattern});
+        }
+        compile();
+    }
+
+    MultiPattern::MultiPattern(std::span<const std::string_view> hex)
+    {
+        m_entries.reserve(hex.size());
+        for (auto& pattern : hex) {
+            m_entries.push_back({parsePattern(pattern)});
+        }
+        compile();
+    }
+
+    size_t MultiPattern::maxPatternSize() const
+    {
+        size_t max = 0;
+        for (auto& entry : m_entries) {
+            max = std::max(max, entry.pattern.bytes.size());
+        }
+        return max;
+    }
+
+    void MultiPattern::compile()
+    {
+        constexpr uint32_t none = UINT32_MAX;
+
+        m_transitions.assign(256, none);
+        m_outputs.assign(1, {});
+
+        for (uint32_t index = 0; index < m_entries.size(); index++) {
+            Entry& entry = m_entries.at(index);
+            const Pattern& pattern = entry.pattern;
+
+            if (!pattern.mask.empty() && pattern.mask.at(0) == '?')
+                throw std::invalid_argument("Mask should not start with a wildcard");
+
+            // Use the longest run of non-wildcard bytes as the fragment fed to the automaton
+            for (size_t j = 0, run = 0; j < pattern.bytes.size(); j++) {
+                bool masked = pattern.mask.length() > j && pattern.mask[j] == '?';
+                run = masked ? 0 : run + 1;
+                if (run > entry.fragmentSize) {
+                    entry.fragmentSize = run;
+                    entry.fragmentOffset = j + 1 - run;
+                }
+            }
+            if (entry.fragmentSize == 0) continue;
+
+            // Insert the fragment into the trie
+            uint32_t state = 0;
+            for (size_t j = entry.fragmentOffset; j < entry.fragmentOffset + entry.fragmentSize; j++) {
+                uint32_t& next = m_transitions.at(state * 256 + pattern.bytes.at(j));
+                if (next == none) {
+                    next = static_cast<uint32_t>(m_outputs.size());
+                    m_transitions.resize(m_transitions.size() + 256, none);
+                    m_outputs.emplace_back();
+                }
+                state = m_transitions.at(state * 256 + pattern.bytes.at(j));
+            }
+            m_outputs.at(state).push_back(index);
+        }
+
+        // Breadth-first walk to resolve failure links into a complete DFA
+        std::vector<uint32_t> fail(m_outputs.size(), 0);
+        std::deque<uint32_t> queue;
+
+        for (size_t byte = 0; byte < 256; byte++) {
+            uint32_t& next = m_transitions.at(byte);
+            if (next == none) {
+                next = 0;
+            } else {
+                queue.push_back(next);
+            }
+        }
+
+        while (!queue.empty()) {
+            uint32_t state = queue.front();
+            queue.pop_front();
+
+            // Inherit outputs from the longest proper suffix that is also a fragment prefix
+            const auto& inherited = m_outputs.at(fail.at(state));
+            m_outputs.at(state).insert(m_outputs.at(state).end(), inherited.begin(), inherited.end());
+
+            for (size_t byte = 0; byte < 256; byte++) {
+                uint32_t& next = m_transitions.at(state * 256 + byte);
+                uint32_t fallback = m_transitions.at(fail.at(state) * 256 + byte);
+                if (next == none) {
+                    next = fallback;
+                } else {
+                    fail.at(next) = fallback;
+                    queue.push_back(next);
+                }
+            }
+        }
+    }
+
+    std::vector<std::vector<uintptr_t>> MultiPattern::search(const void* haystack, size_t haystackSize, bool first) const
+    {
+        std::vector<std::vector<uintptr_t>> found(m_entries.size());
+
+        if (!haystack || haystackSize < 1 || m_entries.empty() || m_transitions.empty())
+            return found;
+
+        const uint8_t* h = static_cast<const uint8_t*>(haystack);
+        const uint32_t* transitions = m_transitions.data();
+        // Entries without a fragment (empty patterns) are never in the automaton and never match
+        size_t remaining = std::count_if(m_entries.begin(), m_entries.end(), [](const Entry& entry) { return entry.fragmentSize > 0; });
+
+        uint32_t state = 0;
+        for (size_t i = 0; i < haystackSize; i++) {
+            state = transitions[state * 256 + h[i]];
+
+            for (uint32_t index : m_outputs[state]) {
+                if (first && !found[index].empty()) continue;
+
+                const Entry& entry = m_entries[index];
+                const Pattern& pattern = entry.pattern;
+
+                // The fragment ends at i, so work back to where the whole pattern would start
+                if (i + 1 < entry.fragmentOffset + entry.fragmentSize) continue;
+                size_t start = i + 1 - entry.fragmentSize - entry.fragmentOffset;
+                if (start + pattern.bytes.size() > haystackSize) continue;
+
+                bool matched = true;
+                for (size_t j = 0; j < pattern.bytes.size() && matched; j++) {
+                    bool masked = pattern.mask.length() > j && pattern.mask[j] == '?';
+                    matched = masked || h[start + j] == pattern.bytes[j];
+                }
+
+                if (matched) {
+                    found[index].push_back(start);
+                    if (first && --remaining == 0) return found;
+                }
+            }
+        }
+
+        return found;
+    }
+} // namespace fatigue::search
@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <cstring>
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+#include "log.hpp"
+#include "mem.hpp"
+#include "ProcessHandle.hpp"
+
+namespace fatigue::mem::uring {
+
+    namespace {
+        /** Submission queue depth of each ring */
+        constexpr unsigned ringEntries = 128;
+        /** Reads and writes larger than this are split into pieces that run concurrently */
+        constexpr size_t pieceSize = 1024 * 1024;
+
+        /**
+         * Minimal io_uring wrapper (no liburing), one per thread
+         * Only supports submitting a batch and waiting for all of it.
+         */
+        class Ring {
+        protected:
+            int m_fd{-1};
+            unsigned m_entries{0};
+
+            void* m_sqRing{MAP_FAILED};
+            size_t m_sqRingSize{0};
+            void* m_cqRing{MAP_FAILED};
+            size_t m_cqRingSize{0};
+            io_uring_sqe* m_sqes{static_cast<io_uring_sqe*>(MAP_FAILED)};
+            size_t m_sqesSize{0};
+
+            unsigned* m_sqTail{nullptr};
+            unsigned* m_sqMask{nullptr};
+            unsigned* m_sqArray{nullptr};
+            unsigned* m_cqHead{nullptr};
+            unsigned* m_cqTail{nullptr};
+            unsigned* m_cqMask{nullptr};
+            io_uring_cqe* m_cqes{nullptr};
+
+        public:
+            Ring()
+            {
+                io_uring_params params{};
+                m_fd = static_cast<int>(syscall(__NR_io_uring_setup, ringEntries, &params));
+                if (m_fd < 0) {
+                    logDebug(std::format("io_uring_setup failed: {}", strerror(errno)));
+                    return;
+                }
+
+                m_entries = params.sq_entries;
+                m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+                m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+                bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+                if (single) m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+
+                m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+                m_cqRing = single ? m_sqRing
+                                  : mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+                m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+                m_sqes = static_cast<io_uring_sqe*>(mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES));
+
+                if (m_sqRing == MAP_FAILED || m_cqRing == MAP_FAILED || m_sqes == MAP_FAILED) {
+                    logDebug(std::format("io_uring mmap failed: {}", strerror(errno)));
+                    close(m_fd);
+                    m_fd = -1;
+                    return;
+                }
+
+                uint8_t* sq = static_cast<uint8_t*>(m_sqRing);
+                uint8_t* cq = static_cast<uint8_t*>(m_cqRing);
+                m_sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+                m_sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+                m_sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+                m_cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+                m_cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+                m_cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+                m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+            }
+
+            ~Ring()
+            {
+                if (m_sqes != MAP_FAILED) munmap(m_sqes, m_sqesSize);
+                if (m_cqRing != MAP_FAILED && m_cqRing != m_sqRing) munmap(m_cqRing, m_cqRingSize);
+                if (m_sqRing != MAP_FAILED) munmap(m_sqRing, m_sqRingSize);
+                if (m_fd >= 0) close(m_fd);
+            }
+
+            Ring(const Ring&) = delete;
+            Ring& operator=(const Ring&) = delete;
+
+            inline bool isValid() const { return m_fd >= 0; }
+            inline unsigned entries() const { return m_entries; }
+
+            /**
+             * Submit one operation per request and wait for all of them, with a single io_uring_enter
+             * unless the kernel takes only part of the batch (then the rest is submitted again as
+             * operations complete, or fails if nothing is left in flight to make room)
+             * @param opcode IORING_OP_READ or IORING_OP_WRITE
+             * @param results Filled with the result of each request (bytes or -errno)
+             * @return false if waiting for completions failed
+             */
+            bool run(int fd, uint8_t opcode, std::span<ReadRequest> requests, std::vector<int64_t>& results)
+            {
+                results.assign(requests.size(), -ECANCELED);
+
+                for (size_t offset = 0; offset < requests.size(); offset += m_entries) {
+                    unsigned count = static_cast<unsigned>(std::min<size_t>(m_entries, requests.size() - offset));
+
+                    const unsigned start = *m_sqTail;
+                    unsigned tail = start;
+                    for (unsigned i = 0; i < count; i++, tail++) {
+                        const ReadRequest& request = requests[offset + i];
+                        unsigned slot = tail & *m_sqMask;
+
+                        io_uring_sqe* sqe = &m_sqes[slot];
+                        memset(sqe, 0, sizeof(*sqe));
+                        sqe->opcode = opcode;
+                        sqe->fd = fd;
+                        sqe->addr = reinterpret_cast<uint64_t>(request.buffer);
+                        // Larger requests come back short rather than with a wrapped length
+                        sqe->len = static_cast<uint32_t>(std::min<size_t>(request.size, UINT32_MAX));
+                        sqe->off = request.address;
+                        sqe->user_data = offset + i;
+
+                        m_sqArray[slot] = slot;
+                    }
+                    __atomic_store_n(m_sqTail, tail, __ATOMIC_RELEASE);
+
+                    unsigned submitted = 0;
+                    unsigned completed = 0;
+                    while (submitted < count || completed < submitted) {
+                        if (submitted < count) {
+                            // Submit what is left and wait for all of it in the same call (the kernel
+                            // does not wait if it could not take every entry, e.g. EAGAIN or EBUSY)
+                            int entered = static_cast<int>(syscall(__NR_io_uring_enter, m_fd, count - submitted, count - completed, IORING_ENTER_GETEVENTS, nullptr, 0));
+                            int error = entered < 0 ? errno : EAGAIN;
+                            if (entered > 0) submitted += static_cast<unsigned>(entered);
+
+                            if (entered <= 0 && error != EINTR && completed == submitted) {
+                                // Nothing in flight to wait for: take back the entries the kernel did not consume
+                                __atomic_store_n(m_sqTail, start + submitted, __ATOMIC_RELEASE);
+                                for (unsigned i = submitted; i < count; i++) results.at(offset + i) = -error;
+                                count = submitted;
+                                continue;
+                            }
+                        }
+
+                        unsigned head = *m_cqHead;
+                        unsigned available = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+
+                        if (head == available) {
+                            if (completed == submitted) continue;
+
+                            // Not everything is done yet (e.g. punted to a worker), wait for the rest
+                            if (syscall(__NR_io_uring_enter, m_fd, 0, submitted - completed, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR) {
+                                __atomic_store_n(m_sqTail, start + submitted, __ATOMIC_RELEASE);
+                                return false;
+                            }
+                            continue;
+                        }
+
+                        for (; head != available; head++, completed++) {
+                            const io_uring_cqe& cqe = m_cqes[head & *m_cqMask];
+                            results.at(cqe.user_data) = cqe.res;
+                        }
+                        __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+                    }
+                }
+
+                return true;
+            }
+        };
+
+        Ring& ring()
+        {
+            thread_local Ring ring;
+            return ring;
+        }
+
+        /** Run a batch on this thread's ring, false if io_uring is unavailable or the submit failed */
+        bool submit(pid_t pid, uint8_t opcode, std::span<ReadRequest> requests)
+        {
+            if (!isAvailable()) return false;
+
+            auto handle = ProcessHandle::get(pid);
+            if (!handle) return false;
+            if (opcode == IORING_OP_WRITE && !handle->isWritable()) return false;
+
+            std::vector<int64_t> results;
+            if (!ring().run(handle->fd(), opcode, requests, results)) return false;
+
+            for (size_t i = 0; i < requests.size(); i++) {
+                requests[i].bytesRead = results.at(i) > 0 ? results.at(i) : 0;
+                requests[i].error = results.at(i) < 0 ? static_cast<int>(-results.at(i)) : 0;
+                if (!requests[i].complete() && requests[i].error == 0) requests[i].error = EFAULT;
+            }
+            return true;
+        }
+
+        /**
+         * Read or write a range split into pieces that are in flight at once (each fits an SQE length)
+         * @param result Like pread and pwrite, bytes done contiguously from the start, or -1
+         * @return false if io_uring could not be used
+         */
+        bool transfer(pid_t pid, uint8_t opcode, uintptr_t address, void* buffer, size_t size, ssize_t& result)
+        {
+            std::vector<ReadRequest> pieces;
+            for (size_t offset = 0; offset < size; offset += pieceSize) {
+                pieces.push_back({
+                    .address = address + offset,
+                    .buffer = static_cast<uint8_t*>(buffer) + offset,
+                    .size = std::min(pieceSize, size - offset)
+                });
+            }
+
+            if (!submit(pid, opcode, pieces)) return false;
+
+            result = 0;
+            for (auto& piece : pieces) {
+                result += piece.bytesRead;
+                if (!piece.complete()) {
+                    errno = piece.error;
+                    break;
+                }
+            }
+            if (result == 0 && pieces.front().error != 0) result = -1;
+            return true;
+        }
+    } // namespace
+
+    bool isAvailable()
+    {
+        static const bool available = [] {
+            bool valid = ring().isValid();
+            if (!valid) logDebug("io_uring is not available, falling back to /proc/pid/mem");
+            return valid;
+        }();
+        return available && ring().isValid();
+    }
+
+    ssize_t read(pid_t pid, uintptr_t address, void* buffer, size_t size)
+    {
+        if (pid <= 0 || address <= 0 || size <= 0) return 0;
+
+        ssize_t bytesRead = 0;
+        if (!transfer(pid, IORING_OP_READ, address, buffer, size, bytesRead)) return io::read(pid, address, buffer, size);
+        return bytesRead;
+    }
+
+    ssize_t write(pid_t pid, uintptr_t address, const void* buffer, size_t size)
+    {
+        if (pid <= 0 || address <= 0 || size <= 0) return 0;
+
+        ssize_t bytesWritten = 0;
+        if (!transfer(pid, IORING_OP_WRITE, address, const_cast<void*>(buffer), size, bytesWritten)) return io::write(pid, address, buffer, size);
+        return bytesWritten;
+    }
+
+    size_t readv(pid_t pid, std::span<ReadRequest> requests)
+    {
+        if (pid <= 0 || requests.empty()) return 0;
+
+        if (!submit(pid, IORING_OP_READ, requests)) {
+            // Without io_uring, process_vm_readv is the next best batched read
+            return sys::readv(pid, requests);
+        }
+
+        return std::count_if(requests.begin(), requests.end(), [](const ReadRequest& request) { return request.complete(); });
+    }
+} // namespace fatigue::mem::uring
@@ -5,10 +5,14 @@
 #endif
 
 #include <algorithm>
+#include <charconv>
 #include <format>
 #include <iomanip>
 #include <iostream>
+#include <span>
+#include <limits>
 #include <sstream>
+#include <type_traits>
 #include <vector>
 
 namespace fatigue {
@@ -46,8 +50,27 @@ namespace fatigue {
          */
         Pattern parsePattern(std::string_view hex);
 
+        /**
+         * Search engine backend, used by search() to choose between vectorized and scalar scanning
+         * Auto picks the best engine supported by the running CPU. Requesting an engine the CPU
+         * does not support will fall back to the best available one.
+         */
+        enum class Engine {
+            Auto,
+            Scalar,
+            SSE2,
+            AVX2
+        };
+
+        void setEngine(Engine engine);
+        Engine getEngine();
+        /** Resolve an engine request (e.g. Auto) to the engine that will actually run on this CPU */
+        Engine resolveEngine(Engine engine);
+
         /**
          * Search for a byte pattern in a memory range
+         * Candidates are filtered on the two rarest non-wildcard bytes of the needle
+         * (vectorized when possible) and then verified against the full needle and mask.
          * @param haystack Pointer to the memory range to search
          * @param haystackSize Size of the memory range to search
          * @param needle Pointer to the byte pattern to search for
@@ -89,6 +112,52 @@ namespace fatigue {
             return search(haystack, haystackSize, parsePattern(hex), first);
         }
 
+        /**
+         * Multiple patterns compiled into a single automaton (Aho-Corasick style)
+         * The longest run of non-wildcard bytes of each pattern is added to one byte-level DFA,
+         * so a single pass over the haystack finds candidates for every pattern at once.
+         * Each candidate is then verified against the full pattern and mask.
+         */
+        class MultiPattern {
+        protected:
+            /** Pattern as added, plus the location of its anchor fragment */
+            struct Entry {
+                Pattern pattern;
+                size_t fragmentOffset{0};
+                size_t fragmentSize{0};
+            };
+
+            std::vector<Entry> m_entries{};
+            /** Dense transition table, 256 entries per state */
+            std::vector<uint32_t> m_transitions{};
+            /** Pattern indices whose fragment ends at each state (including via suffix links) */
+            std::vector<std::vector<uint32_t>> m_outputs{};
+
+            void compile();
+
+        public:
+            MultiPattern() = default;
+            MultiPattern(std::span<const Pattern> patterns);
+            MultiPattern(std::span<const std::string_view> hex);
+            ~MultiPattern() = default;
+
+            /** Number of patterns in the set */
+            inline size_t size() const { return m_entries.size(); }
+            inline bool empty() const { return m_entries.empty(); }
+            inline const Pattern& pattern(size_t index) const { return m_entries.at(index).pattern; }
+            /** Size in bytes of the longest pattern in the set */
+            size_t maxPatternSize() const;
+
+            /**
+             * Search for all patterns in a memory range in a single pass
+             * @param haystack Pointer to the memory range to search
+             * @param haystackSize Size of the memory range to search
+             * @param first If true, only the first match of each pattern is kept
+             * @return One list of match offsets per pattern, in the order the patterns were given
+             */
+            std::vector<std::vector<uintptr_t>> search(const void* haystack, size_t haystackSize, bool first = false) const;
+        };
+
     } // namespace search
 
     namespace string {
@@ -100,6 +169,47 @@ namespace fatigue {
         std::string trim(std::string_view str);
         /** Copy a string and remove all spaces */
         std::string compact(std::string_view str);
+
+        /**
+         * Parse a number, checking it fits in T
+         * Integers are decimal or 0x prefixed hex, with an optional sign; surrounding spaces are ignored
+         * @return false if the whole string is not a number of type T
+         */
+        template <typename T>
+        bool parseNumber(std::string_view text, T& value)
+        {
+            std::string number = trim(text);
+            const char* first = number.data();
+            const char* last = number.data() + number.size();
+
+            if constexpr (std::is_floating_point_v<T>) {
+                if (first != last && *first == '+') first++;
+                auto [end, error] = std::from_chars(first, last, value);
+                return error == std::errc{} && end == last && first != last;
+            } else {
+                bool negative = first != last && *first == '-';
+                if (first != last && (*first == '-' || *first == '+')) first++;
+
+                int base = 10;
+                if (last - first > 2 && first[0] == '0' && (first[1] == 'x' || first[1] == 'X')) {
+                    base = 16;
+                    first += 2;
+                }
+
+                uint64_t magnitude = 0;
+                auto [end, error] = std::from_chars(first, last, magnitude, base);
+                if (error != std::errc{} || end != last || first == last) return false;
+
+                if (negative) {
+                    if (!std::is_signed_v<T> || magnitude > static_cast<uint64_t>(std::numeric_limits<T>::max()) + 1) return false;
+                    value = static_cast<T>(0 - magnitude);
+                } else {
+                    if (magnitude > static_cast<uint64_t>(std::numeric_limits<T>::max())) return false;
+                    value = static_cast<T>(magnitude);
+                }
+                return true;
+            }
+        }
     }
 
     namespace hex {
@@ -140,4 +250,41 @@ namespace fatigue {
         /** Print HEX dump from data; formatted with ASCII representation */
         std::string dump(const void* data, std::size_t length, unsigned long long startAddress = 0, std::size_t rowSize = 16, bool showASCII = true);
     } // namespace hex
+
+    namespace hash {
+        /**
+         * Streaming 64-bit xxHash (XXH64)
+         * Input is consumed in 32 byte stripes over four independent lanes, so the multiplies of
+         * all lanes are in flight together; hashing runs near memory speed without SIMD intrinsics.
+         * Data can be fed in pieces of any size, the digest is the same as hashing it in one go.
+         */
+        class Hasher {
+        protected:
+            uint64_t m_lanes[4];
+            uint64_t m_seed;
+            uint64_t m_total{0};
+            uint8_t m_buffer[32];
+            size_t m_buffered{0};
+
+        public:
+            explicit Hasher(uint64_t seed = 0);
+
+            /** Add data to the hash */
+            void update(const void* data, size_t size);
+            /** Add the bytes of a value to the hash */
+            template <typename T>
+            void update(const T& value) { update(&value, sizeof(T)); }
+
+            /** Get the hash of everything added so far (more data can still be added) */
+            uint64_t digest() const;
+        };
+
+        /** Hash a chunk of data with XXH64 */
+        inline uint64_t xxh64(const void* data, size_t size, uint64_t seed = 0)
+        {
+            Hasher hasher(seed);
+            hasher.update(data, size);
+            return hasher.digest();
+        }
+    } // namespace hash
 } // namespace fatigue
\ No newline at end of file
@@ -21,10 +21,24 @@ struct options {
     int read = -1;
     std::string patch;
 
+    std::string manifest;
+    std::vector<std::string> groups;
+
+    std::string scan;
+    ScanMode scanMode = ScanMode::Exact;
+    ValueType valueType = ValueType::Int32;
+    ScanValue value;
+    ScanValue valueMax;
+    std::string results;
+    bool newScan = false;
+    int list = 20;
+
     bool dryRun = false;
     bool interactive = false;
     bool verbose = false;
     bool ptrace = false;
+    bool uring = false;
+    bool noCache = false;
     int timeout = -1;
     int delay = -1;
 };
@@ -49,12 +63,24 @@ options parseArgs(int argc, char* args[]) {
         // Actions
         TCLAP::ValueArg<int> readArg("", "read", "Read and display a number of bytes at offset", false, -1, "int", cmd);
         TCLAP::ValueArg<std::string> patchArg("", "patch", "Patch to apply at offset", false, "", "string", cmd);
+        TCLAP::ValueArg<std::string> manifestArg("", "manifest", "Apply every patch of a manifest file (process defaults to the manifest's)", false, "", "path", cmd);
+        TCLAP::MultiArg<std::string> groupArg("g", "group", "Only apply this patch group of the manifest (repeatable)", false, "string", cmd);
+
+        // Value scan options
+        TCLAP::ValueArg<std::string> scanArg("", "scan", "Scan writable memory for a value: exact, range, unknown, changed, unchanged, increased, decreased (continues the previous scan of the process)", false, "", "mode", cmd);
+        TCLAP::ValueArg<std::string> valueArg("", "value", "Value to scan for, 'min..max' for range", false, "", "number", cmd);
+        TCLAP::ValueArg<std::string> typeArg("", "type", "Type of the value: int8..int64, uint8..uint64, float, double (default int32)", false, "int32", "string", cmd);
+        TCLAP::ValueArg<std::string> resultsArg("", "results", "File keeping the scan results between runs (default in $XDG_RUNTIME_DIR/memoryfatigue, per PID)", false, "", "path", cmd);
+        TCLAP::SwitchArg newScanArg("", "new-scan", "Start a new scan, even if there are results to continue", cmd);
+        TCLAP::ValueArg<int> listArg("", "list", "Number of scan results to list (default 20)", false, 20, "int", cmd);
 
         // Flags
         TCLAP::SwitchArg dryRunArg("d", "dry-run", "Dry run, don't apply patches", cmd);
         TCLAP::SwitchArg interactiveArg("i", "interactive", "Interactive mode, prompt before applying patches", cmd);
         TCLAP::SwitchArg verboseArg("v", "verbose", "Verbose output", cmd);
         TCLAP::SwitchArg ptraceArg("P", "ptrace", "Use PTRACE for memory access", cmd);
+        TCLAP::SwitchArg uringArg("U", "uring", "Use io_uring for memory access (falls back if unavailable)", cmd);
+        TCLAP::SwitchArg noCacheArg("", "no-cache", "Always scan for the pattern, do not use or update the signature cache", cmd);
         TCLAP::ValueArg<int> timeoutArg("T", "timeout", "Seconds to wait for process to start", false, 30, "int", cmd);
         TCLAP::ValueArg<int> delayArg("D", "delay", "Milliseconds to wait after process starts (increase if errors on start)", false, 1000, "int", cmd);
 
@@ -71,9 +97,11 @@ options parseArgs(int argc, char* args[]) {
         opts.cmdline = cmdlineArg.getValue();
         opts.statusName = statusNameArg.getValue();
         opts.map = mapArg.getValue();
+        opts.manifest = manifestArg.getValue();
+        opts.groups = groupArg.getValue();
 
-        // At least one of pid, status, or cmdline must be specified
-        if (opts.pid <=0 && opts.statusName.empty() && opts.cmdline.empty()) {
+        // At least one of pid, status, or cmdline must be specified (a manifest names its process)
+        if (opts.pid <=0 && opts.statusName.empty() && opts.cmdline.empty() && opts.manifest.empty()) {
             TCLAP::ArgException err("At least one of PID, status, or cmdline must be specified", "pid/status/cmdline");
             out.failure(cmd, err);
         }
@@ -109,6 +137,58 @@ options parseArgs(int argc, char* args[]) {
             out.failure(cmd, err);
         }
 
+        // A manifest brings its own patches
+        if (!opts.manifest.empty() && (!opts.pattern.empty() || opts.address >= 0 || opts.read >= 0 || !opts.patch.empty())) {
+            TCLAP::ArgException err("Manifest cannot be used with pattern, address, read, or patch", "manifest");
+            out.failure(cmd, err);
+        }
+
+        // Groups only make sense with a manifest
+        if (!opts.groups.empty() && opts.manifest.empty()) {
+            TCLAP::ArgException err("Group requires a manifest", "group");
+            out.failure(cmd, err);
+        }
+
+        // Value scans
+        opts.scan = string::toLower(scanArg.getValue());
+        opts.results = resultsArg.getValue();
+        opts.newScan = newScanArg.getValue();
+        opts.list = listArg.getValue();
+
+        if (!opts.scan.empty()) {
+            if (!parseScanMode(opts.scan, opts.scanMode)) {
+                TCLAP::ArgException err("Scan mode must be exact, range, unknown, changed, unchanged, increased, or decreased", "scan");
+                out.failure(cmd, err);
+            }
+            if (!parseValueType(typeArg.getValue(), opts.valueType)) {
+                TCLAP::ArgException err("Type must be int8..int64, uint8..uint64, float, or double", "type");
+                out.failure(cmd, err);
+            }
+
+            // Exact takes a value, range takes min..max, the others compare with the last scan
+            std::string value = valueArg.getValue();
+            size_t dots = value.find("..");
+            bool valid = true;
+            if (opts.scanMode == ScanMode::Exact) {
+                valid = ScanValue::parse(opts.valueType, value, opts.value);
+            } else if (opts.scanMode == ScanMode::Range) {
+                valid = dots != std::string::npos
+                    && ScanValue::parse(opts.valueType, value.substr(0, dots), opts.value)
+                    && ScanValue::parse(opts.valueType, value.substr(dots + 2), opts.valueMax);
+            } else if (!value.empty()) {
+                valid = false;
+            }
+            if (!valid) {
+                TCLAP::ArgException err(std::format("Value must be a {} number for exact, 'min..max' for range, and empty otherwise", valueTypeName(opts.valueType)), "value");
+                out.failure(cmd, err);
+            }
+
+            if (!opts.manifest.empty() || !opts.pattern.empty() || opts.address >= 0 || opts.read >= 0 || !opts.patch.empty()) {
+                TCLAP::ArgException err("Scan cannot be used with manifest, pattern, address, read, or patch", "scan");
+                out.failure(cmd, err);
+            }
+        }
+
         // If pattern is specified, section must be specified
         if (!opts.pattern.empty() && opts.section.empty()) {
             TCLAP::ArgException err("Section must be specified when using pattern", "section");
@@ -132,11 +212,19 @@ options parseArgs(int argc, char* args[]) {
         opts.interactive = interactiveArg.getValue();
         opts.verbose = verboseArg.getValue();
         opts.ptrace = ptraceArg.getValue();
+        opts.uring = uringArg.getValue();
+        opts.noCache = noCacheArg.getValue();
         opts.timeout = timeoutArg.getValue();
         opts.delay = delayArg.getValue();
 
+        // Only one access method can be forced
+        if (opts.ptrace && opts.uring) {
+            TCLAP::ArgException err("PTRACE and io_uring cannot both be used", "ptrace/uring");
+            out.failure(cmd, err);
+        }
+
         // Some options require verbose to make any sense
-        if (opts.interactive || opts.dryRun || opts.read >= 0 || opts.patch.empty()) {
+        if (opts.interactive || opts.dryRun || opts.read >= 0 || !opts.scan.empty() || (opts.patch.empty() && opts.manifest.empty())) {
             opts.verbose = true;
         }
 
@@ -149,6 +237,13 @@ options parseArgs(int argc, char* args[]) {
     }
 }
 
+// Save the signature cache of the run (if any) and drop it
+void closeSignatureCache()
+{
+    if (auto cache = Patch::getSignatureCache()) cache->save();
+    Patch::setSignatureCache(nullptr);
+}
+
 // Confirm before continuing in interactive mode
 void confirm()
 {
@@ -159,10 +254,163 @@ void confirm()
     // Any key other than 'y' or 'Y' will exit
     if (yn.empty() || (yn[0] != 'y' && yn[0] != 'Y')) {
         std::cout << "Exiting..." << std::endl;
+        closeSignatureCache();
         exit(0);
     }
 }
 
+// Apply the patch groups of a manifest, each one all or nothing
+bool applyManifest(const Manifest& manifest, const pe::PeMap& module, uint64_t fingerprint, const options& opts)
+{
+    const ManifestVariant* variant = manifest.findVariant(fingerprint);
+    if (variant) {
+        logInfo(std::format("Build variant '{}'", variant->name));
+    } else if (!manifest.variants().empty()) {
+        logWarning(std::format("Unknown build {:016x}, only patches for every variant apply", fingerprint));
+    }
+
+    auto sets = manifest.patchSets(module, variant, opts.groups);
+    if (sets.empty()) {
+        logError("No patches to apply");
+        return false;
+    }
+
+    bool applied = true;
+    for (auto& [group, patches] : sets) {
+        if (!patches.resolve()) {
+            logError(std::format("Patch group '{}' not found, skipping", group));
+            applied = false;
+            continue;
+        }
+        logInfo(std::format("Patch group '{}' ({} patches)\n{}", group, patches.size(), patches.dump()));
+
+        if (opts.dryRun) continue;
+        if (opts.interactive) confirm();
+
+        if (patches.apply()) {
+            logInfo("...Ok");
+        } else {
+            logError(std::format("Failed to apply patch group '{}'", group));
+            applied = false;
+        }
+    }
+
+    if (opts.dryRun) logInfo("Dry run, nothing applied");
+    return applied;
+}
+
+// Read, patch or search a pattern in the section
+int patchSection(const Region& section, const options& opts)
+{
+    if (!section.isValid()) {
+        logError(std::format("Failed to find section '{}'", opts.section));
+        return 1;
+    }
+
+    /****************************************************
+     * Create the Patch object and perform the action
+     ****************************************************/
+
+    if (opts.interactive) confirm();
+
+    if (opts.address >= 0 && opts.offset != 0) {
+        logWarning("Ignoring offset for specified address");
+    }
+
+    Patch patch;
+
+    // Get the address from the pattern or use the specified address
+    if (opts.address >= 0) {
+        patch = Patch(section, opts.address, opts.patch);
+    } else {
+        patch = Patch(section, opts.pattern, opts.offset, opts.patch);
+
+        if (!patch.isValid()) {
+            logError("Pattern not found");
+            return 1;
+        }
+    }
+
+    if (opts.read >= 0) {
+        // if read, read and display the bytes
+        std::vector<uint8_t> data(opts.read);
+        if (patch.region().read(patch.address(), data.data(), data.size())) {
+            logInfo(std::format(
+                "Read {} bytes in region {}\n{}",
+                data.size(), patch.region().toString(),
+                hex::dump(data.data(), data.size(), patch.address())
+            ));
+        } else {
+            logError(std::format("Failed to read {} bytes at {:#x} in {}", opts.read, patch.address(), patch.region().toString()));
+            return 1;
+        }
+
+    } else if (!opts.patch.empty()) {
+        // if patch, display and apply the patch
+        logInfo(patch.dump());
+
+        // if dry run, we're done
+        if (opts.dryRun) {
+            logInfo("Dry run, exiting");
+            return 0;
+        }
+
+        // Confirm before continuing in interactive mode
+        if (opts.interactive) confirm();
+
+        // Apply the patch
+        if (patch.apply()) {
+            logInfo(std::format("Patch applied\n{}", patch.dumpPatch()));
+        } else {
+            logError("Failed to apply patch");
+            return 1;
+        }
+
+    } else {
+        // Nothing to do, just print some stuff
+        if (opts.address >= 0) {
+            logInfo(std::format("Address {:#x} in region {}", opts.address, patch.region().toString()));
+        } else {
+            logInfo(std::format("Pattern search in region {}\n{}", patch.region().toString(), patch.dumpPattern()));
+        }
+    }
+
+    return 0;
+}
+
+// Run one value scan, continuing the results of the previous run when there are any
+bool scanValues(pid_t pid, const options& opts)
+{
+    ValueScanner scanner(pid, opts.valueType);
+    std::string path = opts.results.empty() ? ValueScanner::defaultStorePath(pid) : opts.results;
+    bool resume = scanner.useStore(path) && !opts.newScan && opts.scanMode != ScanMode::Unknown;
+
+    if (resume) {
+        logInfo(std::format("Scan {} of {} {} candidates ({})", scanner.scans() + 1, scanner.count(), valueTypeName(opts.valueType), path));
+        if (!scanner.nextScan(opts.scanMode, opts.value, opts.valueMax)) return false;
+    } else {
+        if (opts.scanMode != ScanMode::Exact && opts.scanMode != ScanMode::Range && opts.scanMode != ScanMode::Unknown) {
+            logError(std::format("No scan to continue in {}, start with exact, range, or unknown", path));
+            return false;
+        }
+        logInfo(std::format("New {} scan ({})", valueTypeName(opts.valueType), path));
+        if (!scanner.firstScan(opts.scanMode, opts.value, opts.valueMax)) return false;
+    }
+
+    logInfo(std::format("{} candidates on {} pages", scanner.count(), scanner.pageCount()));
+
+    size_t listed = 0;
+    scanner.forEach([&](uintptr_t address, const uint8_t* value) {
+        if (listed >= static_cast<size_t>(std::max(opts.list, 0))) return false;
+        logInfo(std::format("{:#x}  {}", address, ScanValue::format(opts.valueType, value)));
+        listed++;
+        return true;
+    });
+    if (listed < scanner.count()) logInfo(std::format("... and {} more", scanner.count() - listed));
+
+    return true;
+}
+
 // Main entry point
 
 int main(int argc, char* args[])
@@ -183,35 +431,61 @@ int main(int argc, char* args[])
         "pid: {}, status: '{}', cmdline: '{}'\n"
         "section: '{}', pattern: '{}', offset: {}, patch: '{}'\n"
         "dryRun: {}, interactive: {}, verbose: {}\n"
-        "ptrace: {}, timeout: {}, delay: {}",
+        "ptrace: {}, uring: {}, timeout: {}, delay: {}",
         opts.pid, opts.statusName, opts.cmdline,
         opts.section, opts.pattern, opts.offset, opts.patch,
         opts.dryRun, opts.interactive, opts.verbose,
-        opts.ptrace, opts.timeout, opts.delay
+        opts.ptrace, opts.uring, opts.timeout, opts.delay
     ));
 
     // Use IO if available, otherwise use PTRACE
     if (opts.ptrace) {
         logInfo("Using PTRACE for memory access");
         mem::setAccessMethod(mem::AccessMethod::PTRACE);
+    } else if (opts.uring) {
+        logInfo(mem::uring::isAvailable() ? "Using io_uring for memory access" : "io_uring is not available, using IO");
+        mem::setAccessMethod(mem::AccessMethod::URING);
     } else {
         mem::setAccessMethod(mem::AccessMethod::IO);
     }
 
+    // Load the manifest first, a broken one should not wait for the process
+    Manifest manifest;
+    if (!opts.manifest.empty()) {
+        manifest = Manifest(opts.manifest);
+        if (!manifest.isValid()) {
+            logError(std::format("Failed to load manifest {}", opts.manifest));
+            return 1;
+        }
+        logInfo(std::format("Manifest {} ({} patches{})", manifest.name().empty() ? opts.manifest : manifest.name(),
+            manifest.patches().size(), manifest.isPrecompiled() ? ", compiled" : ""));
+
+        if (opts.map.empty()) opts.map = manifest.module();
+    }
+
     /****************************************************
      * Find and attach to process
      ****************************************************/
 
-    pid_t pid = proc::waitForProcess([&opts]() {
-        if (opts.pid > 0) {
-            return opts.pid;
-        } else if (!opts.statusName.empty()) {
-            return proc::getProcessIdByStatusName(opts.statusName);
-        } else if (!opts.cmdline.empty()) {
-            return proc::getProcessIdByCmdlineContains(opts.cmdline);
-        }
-        return 0;
-    }, opts.timeout);
+    pid_t pid = opts.pid;
+    proc::ProcessScanner::Filter filter = !opts.statusName.empty()
+        ? proc::matchStatusName(opts.statusName)
+        : proc::matchCmdlineContains(opts.cmdline);
+
+    // Without a process on the command line, any process of the manifest will do
+    if (opts.pid <= 0 && opts.statusName.empty() && opts.cmdline.empty()) {
+        std::vector<proc::ProcessScanner::Filter> filters;
+        for (const std::string& process : manifest.processes()) filters.push_back(proc::matchStatusName(process));
+        filter = [filters](pid_t candidate) {
+            return std::any_of(filters.begin(), filters.end(), [candidate](const auto& match) { return match(candidate); });
+        };
+    }
+
+    if (pid <= 0) {
+        // Wait until the process appears (on exec if possible, otherwise by scanning /proc)
+        proc::ProcessScanner scanner(filter);
+        pid = proc::waitForProcess(scanner, opts.timeout);
+    }
 
     std::string processName;
 
@@ -221,6 +495,8 @@ int main(int argc, char* args[])
         processName = opts.statusName;
     } else if (!opts.cmdline.empty()) {
         processName = opts.cmdline;
+    } else if (manifest.isValid()) {
+        processName = manifest.module();
     }
 
     if (pid <= 0) {
@@ -274,8 +550,8 @@ int main(int argc, char* args[])
         return 0;
     } // end show maps
 
-    // If no address or pattern, then we're done
-    if (opts.address < 0 && opts.pattern.empty()) {
+    // If no address, pattern, manifest, or scan, then we're done
+    if (opts.address < 0 && opts.pattern.empty() && !manifest.isValid() && opts.scan.empty()) {
         logInfo("No pattern specified, exiting");
         return 0;
     }
@@ -283,6 +559,18 @@ int main(int argc, char* args[])
     // delay to allow process to start
     proc::wait(opts.delay);
 
+    // Several processes can match (e.g. launcher and game under Proton), use the newest one mapping the image
+    if (opts.pid <= 0) {
+        auto candidates = proc::findProcesses(filter);
+        if (candidates.size() > 1) {
+            pid_t best = proc::rankProcesses(candidates, {.image = opts.map.empty() ? processName : opts.map});
+            if (best > 0 && best != pid) {
+                logInfo(std::format("{} processes match, using {}", candidates.size(), best));
+                pid = best;
+            }
+        }
+    }
+
     // Attach to process
     if(!proc::attach(pid)) {
         logError(std::format("Failed to attach to process {}", pid));
@@ -291,6 +579,11 @@ int main(int argc, char* args[])
 
     logInfo(std::format("Found and attached to {} ({})", processName, pid));
 
+    // A value scan does not need the module, the process stays stopped while it runs
+    if (!opts.scan.empty()) {
+        return scanValues(pid, opts) ? 0 : 1;
+    }
+
     /****************************************************
      * Find the process map and working region
      ****************************************************/
@@ -322,9 +615,21 @@ int main(int argc, char* args[])
             logError("Failed to read PE headers");
             return 1;
         }
+        uint64_t fingerprint = peMap.fingerprint();
+        logInfo(std::format("Build fingerprint {:016x}", fingerprint));
 
         section = peMap.getSection(opts.section);
 
+        // Remember where the pattern was found, the next run against the same exe only verifies it
+        if (!opts.noCache) Patch::setSignatureCache(std::make_shared<SignatureCache>(peMap));
+
+        if (manifest.isValid()) {
+            // Interactive mode asks once per group, after showing what it will write
+            bool applied = applyManifest(manifest, peMap, fingerprint, opts);
+            closeSignatureCache();
+            return applied ? 0 : 1;
+        }
+
     } else if (elf::isValidElf(map)) {
         // Otherwise, check if process is ELF (section is ignored)
         elf::ElfMap elfMap(map);
@@ -334,6 +639,11 @@ int main(int argc, char* args[])
             return 1;
         }
 
+        if (manifest.isValid()) {
+            logError("Manifests only support PE processes");
+            return 1;
+        }
+
         // ! IMPORTANT: ELF support is experimental, but will likely work for read operations
         // ! Because of this, we are going to print a huge warning to the user and force interactive mode
         if (!opts.patch.empty()) {
@@ -351,78 +661,8 @@ int main(int argc, char* args[])
         return 1;
     }
 
-    if (!section.isValid()) {
-        logError(std::format("Failed to find section '{}'", opts.section));
-        return 1;
-    }
-
-    /****************************************************
-     * Create the Patch object and perform the action
-     ****************************************************/
-
-    if (opts.interactive) confirm();
-
-    if (opts.address >= 0 && opts.offset != 0) {
-        logWarning("Ignoring offset for specified address");
-    }
-
-    Patch patch;
-
-    // Get the address from the pattern or use the specified address
-    if (opts.address >= 0) {
-        patch = Patch(section, opts.address, opts.patch);
-    } else {
-        patch = Patch(section, opts.pattern, opts.offset, opts.patch);
-
-        if (!patch.isValid()) {
-            logError("Pattern not found");
-            return 1;
-        }
-    }
-
-    if (opts.read >= 0) {
-        // if read, read and display the bytes
-        std::vector<uint8_t> data(opts.read);
-        if (patch.region().read(patch.address(), data.data(), data.size())) {
-            logInfo(std::format(
-                "Read {} bytes in region {}\n{}",
-                data.size(), patch.region().toString(),
-                hex::dump(data.data(), data.size(), patch.address())
-            ));
-        } else {
-            logError(std::format("Failed to read {} bytes at {:#x} in {}", opts.read, patch.address(), patch.region().toString()));
-            return 1;
-        }
-
-    } else if (!opts.patch.empty()) {
-        // if patch, display and apply the patch
-        logInfo(patch.dump());
-
-        // if dry run, we're done
-        if (opts.dryRun) {
-            logInfo("Dry run, exiting");
-            return 0;
-        }
-
-        // Confirm before continuing in interactive mode
-        if (opts.interactive) confirm();
-
-        // Apply the patch
-        if (patch.apply()) {
-            logInfo(std::format("Patch applied\n{}", patch.dumpPatch()));
-        } else {
-            logError("Failed to apply patch");
-            return 1;
-        }
-
-    } else {
-        // Nothing to do, just print some stuff
-        if (opts.address >= 0) {
-            logInfo(std::format("Address {:#x} in region {}", opts.address, patch.region().toString()));
-        } else {
-            logInfo(std::format("Pattern search in region {}\n{}", patch.region().toString(), patch.dumpPattern()));
-        }
-    }
-
-    return 0;
+    // Save what the signature cache learned while logging still works, not from a static destructor
+    int result = patchSection(section, opts);
+    closeSignatureCache();
+    return result;
 }
\ No newline at end of file
@@ -14,6 +14,7 @@ struct options {
     sekiro::Resolution resolution { -1, -1 };
     bool cameraReset = false;
     bool autoloot = false;
+    bool noCache = false;
     bool verbose = false;
     int timeout = -1;
     int delay = -1;
@@ -27,6 +28,7 @@ options parseArgs(int argc, char* args[]) {
         TCLAP::ValueArg<std::string> resolutionArg("r", "resolution", "Game resolution (WxH), e.g. '3440x1440'", false, "", "string", cmd);
         TCLAP::SwitchArg cameraResetArg("c", "no-camera-reset", "Disable camera reset on lock-on when no target", cmd);
         TCLAP::SwitchArg autolootArg("a", "autoloot", "Enable autoloot", cmd);
+        TCLAP::SwitchArg noCacheArg("", "no-cache", "Always scan for patterns, do not use or update the signature cache", cmd);
 
         TCLAP::SwitchArg verboseArg("v", "verbose", "Verbose output", cmd);
         TCLAP::ValueArg<int> timeoutArg("T", "timeout", "Seconds to wait for game to start", false, 30, "int", cmd);
@@ -64,6 +66,7 @@ options parseArgs(int argc, char* args[]) {
 
         opts.cameraReset = cameraResetArg.getValue();
         opts.autoloot = autolootArg.getValue();
+        opts.noCache = noCacheArg.getValue();
 
         opts.verbose = verboseArg.getValue();
         opts.timeout = timeoutArg.getValue();
@@ -86,32 +89,33 @@ bool patchFps(Region const &text, Region const &data, int fps)
     float speedFixPatch = sekiro::findSpeedFixForRefreshRate(fps);
 
     // Framelock (fps delta) and speed fix must both be applied or not at all
-    Patch patchFramelock(text,
-                         sekiro::PATTERN_FRAMELOCK_FUZZY,
-                         sekiro::PATTERN_FRAMELOCK_FUZZY_OFFSET,
-                         &framelockPatch, sizeof(framelockPatch));
-
-    Patch patchSpeedFix(text,
-                        sekiro::PATTERN_FRAMELOCK_SPEED_FIX,
-                        [](Patch const &patch) {
-                            int speedFixOffset = sekiro::PATTERN_FRAMELOCK_SPEED_FIX_OFFSET;
-                            // Credit to @Lahvuun for sekirofpsunlock for the following
-                            // At the original offset lives an internal offset to the actual speed fix address, so read it
-                            uint32_t speedFixInternalOffset;
-                            patch.region().read(patch.address() + speedFixOffset, &speedFixInternalOffset);
-                            // Then find the actual offset by adding the internal offset value to the end of the original offset (+4 bytes)
-                            return speedFixOffset + 4 + speedFixInternalOffset;
-                        },
-                        &speedFixPatch, sizeof(speedFixPatch));
-
-    if (patchFramelock.isValid() && patchSpeedFix.isValid()) {
+    PatchSet patches;
+    patches.add(text,
+                sekiro::PATTERN_FRAMELOCK_FUZZY,
+                sekiro::PATTERN_FRAMELOCK_FUZZY_OFFSET,
+                &framelockPatch, sizeof(framelockPatch));
+
+    patches.add(text,
+                sekiro::PATTERN_FRAMELOCK_SPEED_FIX,
+                [](Patch const &patch) {
+                    int speedFixOffset = sekiro::PATTERN_FRAMELOCK_SPEED_FIX_OFFSET;
+                    // Credit to @Lahvuun for sekirofpsunlock for the following
+                    // At the original offset lives an internal offset to the actual speed fix address, so read it
+                    uint32_t speedFixInternalOffset;
+                    patch.region().read(patch.address() + speedFixOffset, &speedFixInternalOffset);
+                    // Then find the actual offset by adding the internal offset value to the end of the original offset (+4 bytes)
+                    return speedFixOffset + 4 + speedFixInternalOffset;
+                },
+                &speedFixPatch, sizeof(speedFixPatch));
+
+    if (patches.resolve()) {
         logInfo(std::format("Patching FPS to {} (speed fix {})", fps, speedFixPatch));
     } else {
         logWarning("Framelock or speed fix not found");
         return false;
     }
 
-    if (patchFramelock.apply() && patchSpeedFix.apply()) {
+    if (patches.apply()) {
         logInfo("...Ok");
         return true;
     } else {
@@ -124,23 +128,24 @@ bool patchFps(Region const &text, Region const &data, int fps)
 bool patchResolution(Region const &text, Region const &data, sekiro::Resolution const &resolution)
 {
     // Width, height, and scaling fix (allow widescreen) must all be applied or not at all
-    Patch patchResolution(data,
-                          resolution.width < 1920
-                              ? sekiro::PATTERN_RESOLUTION_DEFAULT_720
-                              : sekiro::PATTERN_RESOLUTION_DEFAULT,
-                          0,
-                          &resolution, sizeof(resolution));
+    PatchSet patches;
+    patches.add(data,
+                resolution.width < 1920
+                    ? sekiro::PATTERN_RESOLUTION_DEFAULT_720
+                    : sekiro::PATTERN_RESOLUTION_DEFAULT,
+                0,
+                &resolution, sizeof(resolution));
 
-    Patch patchScalingFix(text, sekiro::PATTERN_RESOLUTION_SCALING_FIX, 0, sekiro::PATCH_RESOLUTION_SCALING_FIX_ENABLE);
+    patches.add(text, sekiro::PATTERN_RESOLUTION_SCALING_FIX, 0, sekiro::PATCH_RESOLUTION_SCALING_FIX_ENABLE);
 
-    if (patchResolution.isValid() && patchScalingFix.isValid()) {
+    if (patches.resolve()) {
         logInfo(std::format("Patching resolution to {}x{}", resolution.width, resolution.height));
     } else {
         logWarning("Resolution or scaling fix not found");
         return false;
     }
 
-    if (patchResolution.apply() && patchScalingFix.apply()) {
+    if (patches.apply()) {
         logInfo("...Ok");
         return true;
     } else {
@@ -224,9 +229,8 @@ int main(int argc, char* args[])
     // for a Windows game, we are most interested in the .exe name
     std::string processName = sekiro::PROCESS_NAME;
 
-    pid_t pid = proc::waitForProcess([&processName]() {
-        return proc::getProcessIdByStatusName(processName);
-    }, opts.timeout);
+    proc::ProcessScanner scanner(proc::matchStatusName(processName));
+    pid_t pid = proc::waitForProcess(scanner, opts.timeout);
 
     if (pid <= 0) {
         logError(std::format("Failed to find process '{}'", processName));
@@ -236,6 +240,13 @@ int main(int argc, char* args[])
     // delay to allow process to start
     proc::wait(opts.delay);
 
+    // Several processes can carry the exe name under Proton, use the newest one that maps the exe
+    auto candidates = proc::findProcesses(proc::matchStatusName(processName));
+    if (candidates.size() > 1) {
+        pid_t best = proc::rankProcesses(candidates, {.image = processName});
+        if (best > 0) pid = best;
+    }
+
     // Attach to process
     if(!proc::attach(pid)) {
         logError(std::format("Failed to attach to process {}", pid));
@@ -253,6 +264,9 @@ int main(int argc, char* args[])
         return 1;
     }
 
+    // Identifies the exact build (e.g. to tell legacy versions apart) from a single read of the headers
+    logInfo(std::format("Build fingerprint {:016x}", peMap.fingerprint()));
+
     // Find the .text and .data sections
     Region text = peMap.getSection(".text");
     text.enforceBounds = false; // Allow out of bounds write (speed fix points outside .text)
@@ -267,6 +281,21 @@ int main(int argc, char* args[])
         return 1;
     }
 
+    // Remember where each pattern was found, so the next start of the same exe skips the scans
+    std::shared_ptr<SignatureCache> cache = nullptr;
+    if (!opts.noCache) {
+        cache = std::make_shared<SignatureCache>(peMap);
+        Patch::setSignatureCache(cache);
+    }
+
+    // Keep a local copy of each section, so every patch searches and backs up from memory
+    // instead of re-reading the whole section (patches share the copy, writes keep it up to date)
+    // Not worth it when the patterns are cached, checking a cached match is a single small read
+    if (!cache || cache->empty()) {
+        text.takeSnapshot();
+        data.takeSnapshot();
+    }
+
     // Apply patches
 
     // FPS
@@ -302,6 +331,8 @@ int main(int argc, char* args[])
         }
     }
 
+    if (cache) cache->save();
+
     // Done!
     logInfo("Done, enjoy!");
     proc::detach(pid);